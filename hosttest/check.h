@@ -0,0 +1,54 @@
+#pragma once
+
+// Checks, a clock and a background-thread harness shared by the host
+// tests.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+static int failures;
+
+#define CHECK(cond)                                       \
+  do {                                                    \
+    if (!(cond)) {                                        \
+      fprintf(stderr, "%s:%d: %s failed\n", __FILE__,     \
+              __LINE__, #cond);                           \
+      __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED); \
+    }                                                     \
+  } while (0)
+
+// Print whether every check passed; nonzero if not.
+static inline int report(char *name) {
+  if (failures) {
+    printf("%s: %d checks FAILED\n", name, failures);
+    return 1;
+  }
+  printf("%s: ok\n", name);
+  return 0;
+}
+
+// Monotonic time in nanoseconds.
+static inline double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Background threads started by bg_start() loop until done(), which
+// becomes true once bg_stop() is called.
+static int bg_done;
+
+static inline int done(void) {
+  return __atomic_load_n(&bg_done, __ATOMIC_RELAXED);
+}
+
+static inline void bg_start(pthread_t *t, int n, void *(*fn)(void *)) {
+  __atomic_store_n(&bg_done, 0, __ATOMIC_RELAXED);
+  for (int i = 0; i < n; i++) pthread_create(&t[i], 0, fn, 0);
+}
+
+static inline void bg_stop(pthread_t *t, int n) {
+  __atomic_store_n(&bg_done, 1, __ATOMIC_RELAXED);
+  for (int i = 0; i < n; i++) pthread_join(t[i], 0);
+}
@@ -0,0 +1,184 @@
+// Tests and a lookup benchmark for kernel/util/hashtable.c, run on the
+// host by make hosttest.
+
+#include <stdlib.h>
+
+#include "hosttest/check.h"
+#include "kernel/util/epoch.h"
+#include "kernel/util/hashtable.h"
+
+struct item {
+  int value;
+  int seen;
+  struct ht_node node;
+  struct item *next;  // for the linear-scan comparison
+};
+
+static struct item *find(struct hashtable *ht, uint64 key) {
+  struct ht_bucket *b = ht_lock(ht, key);
+  struct ht_node *n = ht_find(b, key);
+  ht_unlock(ht, b);
+  return n ? ht_container(n, struct item, node) : 0;
+}
+
+static int count_key(struct hashtable *ht, uint64 key) {
+  int c = 0;
+  struct ht_bucket *b = ht_lock(ht, key);
+  for (struct ht_node *n = ht_find(b, key); n; n = ht_find_next(n, key)) c++;
+  ht_unlock(ht, b);
+  return c;
+}
+
+static void test_basic(void) {
+  struct hashtable ht;
+  struct item a = {.value = 1}, b = {.value = 2}, c = {.value = 3};
+
+  CHECK(ht_init(&ht, "test", 4) == 0);
+  CHECK(find(&ht, 7) == 0);
+  ht_insert(&ht, &a.node, 7);
+  ht_insert(&ht, &b.node, 8);
+  ht_insert(&ht, &c.node, 7);
+  CHECK(ht.count == 3);
+  CHECK(find(&ht, 8) == &b);
+  CHECK(count_key(&ht, 7) == 2);
+  ht_remove(&ht, &a.node);
+  CHECK(find(&ht, 7) == &c);
+  CHECK(count_key(&ht, 7) == 1);
+  ht_remove(&ht, &b.node);
+  ht_remove(&ht, &c.node);
+  CHECK(ht.count == 0);
+  CHECK(find(&ht, 7) == 0 && find(&ht, 8) == 0);
+  ht_destroy(&ht);
+  epoch_poll();
+}
+
+static int visit(struct ht_node *n, void *arg) {
+  ht_container(n, struct item, node)->seen++;
+  (*(int *)arg)++;
+  return 0;
+}
+
+static int stop_at_third(struct ht_node *n, void *arg) {
+  return ++*(int *)arg == 3 ? 42 : 0;
+}
+
+// Growing past the load factor, explicit resizes and iteration keep
+// every node findable exactly once.
+static void test_resize(void) {
+  enum { N = 10000 };
+  struct hashtable ht;
+  struct item *items = calloc(N, sizeof(*items));
+  int visited = 0;
+
+  CHECK(ht_init(&ht, "test", 1) == 0);
+  for (int i = 0; i < N; i++) ht_insert(&ht, &items[i].node, i * 4096);
+  CHECK(ht_resize(&ht, 3) == 0);
+  CHECK(ht_resize(&ht, 1 << 14) == 0);
+  for (int i = 0; i < N; i++) CHECK(find(&ht, i * 4096) == &items[i]);
+
+  CHECK(ht_foreach(&ht, visit, &visited) == 0);
+  CHECK(visited == N);
+  for (int i = 0; i < N; i++) CHECK(items[i].seen == 1);
+  visited = 0;
+  CHECK(ht_foreach(&ht, stop_at_third, &visited) == 42);
+  CHECK(visited == 3);
+
+  for (int i = 0; i < N; i++) ht_remove(&ht, &items[i].node);
+  CHECK(ht.count == 0);
+  ht_destroy(&ht);
+  epoch_poll();
+  free(items);
+}
+
+// Threads add, look up and remove their own keys while another thread
+// keeps resizing the table.
+enum { NTHREAD = 4, PER_THREAD = 2000, ROUNDS = 20 };
+static struct hashtable shared;
+
+static void *worker(void *arg) {
+  long t = (long)arg;
+  struct item *items = calloc(PER_THREAD, sizeof(*items));
+
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < PER_THREAD; i++)
+      ht_insert(&shared, &items[i].node, t * PER_THREAD + i);
+    for (int i = 0; i < PER_THREAD; i++)
+      CHECK(find(&shared, t * PER_THREAD + i) == &items[i]);
+    for (int i = 0; i < PER_THREAD; i++) ht_remove(&shared, &items[i].node);
+    for (int i = 0; i < PER_THREAD; i += 97)
+      CHECK(find(&shared, t * PER_THREAD + i) == 0);
+  }
+  free(items);
+  return 0;
+}
+
+static void *resizer(void *arg) {
+  for (int n = 1; !done(); n = n * 2 % 8192 + 1) ht_resize(&shared, n);
+  return 0;
+}
+
+static void test_concurrent(void) {
+  pthread_t w[NTHREAD], r;
+
+  CHECK(ht_init(&shared, "test", 1) == 0);
+  bg_start(&r, 1, resizer);
+  for (long t = 0; t < NTHREAD; t++)
+    pthread_create(&w[t], 0, worker, (void *)t);
+  for (int t = 0; t < NTHREAD; t++) pthread_join(w[t], 0);
+  bg_stop(&r, 1);
+  CHECK(shared.count == 0);
+  ht_destroy(&shared);
+  epoch_poll();
+}
+
+// Lookups of random present keys, against the linear scans the kernel
+// does today (bget(), iget()).
+static void bench(int n) {
+  enum { LOOKUPS = 1000000 };
+  struct hashtable ht;
+  struct item *items = calloc(n, sizeof(*items)), *list = 0;
+  volatile long sink = 0;
+
+  ht_init(&ht, "bench", n);
+  for (int i = 0; i < n; i++) {
+    items[i].value = i;
+    ht_insert(&ht, &items[i].node, (uint64)i << 12 | 1);
+    items[i].next = list;
+    list = &items[i];
+  }
+
+  srand(1);
+  double t0 = now();
+  for (int i = 0; i < LOOKUPS; i++)
+    sink += find(&ht, (uint64)(rand() % n) << 12 | 1)->value;
+  double t1 = now();
+  int scans = n > 1000 ? LOOKUPS / 100 : LOOKUPS;
+  for (int i = 0; i < scans; i++) {
+    int v = rand() % n;
+    for (struct item *it = list; it; it = it->next)
+      if (it->value == v) {
+        sink += it->value;
+        break;
+      }
+  }
+  double t2 = now();
+
+  printf("hashtable_test: %6d keys: hash %6.1f ns, linear scan %8.1f ns\n",
+         n, (t1 - t0) / LOOKUPS, (t2 - t1) / scans);
+  for (int i = 0; i < n; i++) ht_remove(&ht, &items[i].node);
+  ht_destroy(&ht);
+  epoch_poll();
+  free(items);
+}
+
+int main(int argc, char *argv[]) {
+  test_basic();
+  test_resize();
+  test_concurrent();
+  if (report("hashtable_test")) return 1;
+
+  bench(30);
+  bench(200);
+  bench(10000);
+  return 0;
+}
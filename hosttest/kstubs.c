@@ -0,0 +1,78 @@
+// Host versions of the kernel services that kernel/util code uses, so
+// that it can be tested and benchmarked as an ordinary program.
+//
+// Spinlocks really spin; push_off()/pop_off() do nothing. Each thread
+// that calls cpuid() gets the next hart number, modulo NCPU. Epoch
+// sections do nothing either: retired objects are only freed by
+// epoch_poll(), which a test calls when no other thread is running.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "kernel/param.h"
+#include "kernel/util/epoch.h"
+#include "kernel/util/spinlock.h"
+
+void initlock(struct spinlock *lk, char *name) {
+  lk->name = name;
+  lk->locked = 0;
+  lk->cpu = 0;
+}
+
+void acquire(struct spinlock *lk) {
+  while (__sync_lock_test_and_set(&lk->locked, 1) != 0)
+    ;
+  __sync_synchronize();
+}
+
+void release(struct spinlock *lk) {
+  __sync_synchronize();
+  __sync_lock_release(&lk->locked);
+}
+
+int holding(struct spinlock *lk) { return lk->locked; }
+
+void push_off(void) {}
+
+void pop_off(void) {}
+
+int cpuid(void) {
+  static int nharts;
+  static __thread int hart = -1;
+
+  if (hart < 0) hart = __atomic_fetch_add(&nharts, 1, __ATOMIC_RELAXED) % NCPU;
+  return hart;
+}
+
+void epoch_enter(void) {}
+
+void epoch_exit(void) {}
+
+static pthread_mutex_t retired_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct epoch_node *retired;
+
+void epoch_retire(struct epoch_node *n, void (*fn)(struct epoch_node *)) {
+  n->free = fn;
+  pthread_mutex_lock(&retired_lock);
+  n->next = retired;
+  retired = n;
+  pthread_mutex_unlock(&retired_lock);
+}
+
+void epoch_poll(void) {
+  pthread_mutex_lock(&retired_lock);
+  while (retired) {
+    struct epoch_node *n = retired;
+    retired = n->next;
+    n->free(n);
+  }
+  pthread_mutex_unlock(&retired_lock);
+}
+
+void kfree(void *p) { free(p); }
+
+void panic(char *s) {
+  fprintf(stderr, "panic: %s\n", s);
+  abort();
+}
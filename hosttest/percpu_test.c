@@ -0,0 +1,108 @@
+// Tests and an update benchmark for kernel/util/percpu.c, run on the
+// host by make hosttest.
+
+#include "hosttest/check.h"
+#include "kernel/util/percpu.h"
+
+static void test_basic(void) {
+  static struct percpu_counter zeroed;
+  struct percpu_counter c;
+
+  // A zeroed counter folds every add.
+  percpu_counter_add(&zeroed, 5);
+  percpu_counter_add(&zeroed, -2);
+  CHECK(percpu_counter_read(&zeroed) == 3);
+  CHECK(percpu_counter_sum(&zeroed) == 3);
+
+  percpu_counter_init(&c, 100, 10);
+  for (int i = 0; i < 9; i++) percpu_counter_add(&c, 1);
+  CHECK(percpu_counter_read(&c) == 100);
+  CHECK(percpu_counter_sum(&c) == 109);
+  percpu_counter_add(&c, 1);
+  CHECK(percpu_counter_read(&c) == 110);
+  percpu_counter_add(&c, -25);
+  CHECK(percpu_counter_read(&c) == 85);
+  CHECK(percpu_counter_sum(&c) == 85);
+}
+
+// Harts add and take away while a reader checks that the cheap read
+// stays within NCPU * batch of the truth.
+enum { BATCH = 32, ROUNDS = 200000 };
+static struct percpu_counter shared;
+
+static void *adder(void *arg) {
+  for (int i = 0; i < ROUNDS; i++) {
+    percpu_counter_add(&shared, 3);
+    percpu_counter_add(&shared, -1);
+  }
+  return 0;
+}
+
+static void *reader(void *arg) {
+  while (!done()) {
+    long r = percpu_counter_read(&shared);
+    CHECK(r >= -(long)NCPU * BATCH);
+    CHECK(r <= 2L * ROUNDS * (NCPU - 1) + (long)NCPU * BATCH);
+  }
+  return 0;
+}
+
+static void test_concurrent(void) {
+  pthread_t a[NCPU - 1], r;
+
+  percpu_counter_init(&shared, 0, BATCH);
+  // The reader takes a hart too, but never adds.
+  bg_start(&r, 1, reader);
+  for (int t = 0; t < NCPU - 1; t++) pthread_create(&a[t], 0, adder, 0);
+  for (int t = 0; t < NCPU - 1; t++) pthread_join(a[t], 0);
+  bg_stop(&r, 1);
+  CHECK(percpu_counter_sum(&shared) == 2L * ROUNDS * (NCPU - 1));
+  long r2 = percpu_counter_read(&shared);
+  CHECK(r2 > 2L * ROUNDS * (NCPU - 1) - (long)NCPU * BATCH);
+}
+
+// Increments from several threads at once, against one shared atomic.
+static struct percpu_counter bench_pcc;
+static long bench_atomic;
+enum { OPS = 2000000 };
+
+static void *inc_percpu(void *arg) {
+  for (int i = 0; i < OPS; i++) percpu_counter_add(&bench_pcc, 1);
+  return 0;
+}
+
+static void *inc_atomic(void *arg) {
+  for (int i = 0; i < OPS; i++)
+    __atomic_fetch_add(&bench_atomic, 1, __ATOMIC_RELAXED);
+  return 0;
+}
+
+static double run(int n, void *(*fn)(void *)) {
+  pthread_t t[NCPU];
+
+  double t0 = now();
+  for (int i = 0; i < n; i++) pthread_create(&t[i], 0, fn, 0);
+  for (int i = 0; i < n; i++) pthread_join(t[i], 0);
+  return (now() - t0) / OPS;
+}
+
+static void bench(int n) {
+  percpu_counter_init(&bench_pcc, 0, PERCPU_NOFOLD);
+  double p = run(n, inc_percpu);
+  double a = run(n, inc_atomic);
+  CHECK(percpu_counter_sum(&bench_pcc) == (long)n * OPS);
+  printf("percpu_test: %d threads: percpu %5.1f ns, atomic %5.1f ns\n", n, p,
+         a);
+}
+
+int main(int argc, char *argv[]) {
+  test_basic();
+  test_concurrent();
+  if (report("percpu_test")) return 1;
+
+  // Threads started together get different harts, as long as there are
+  // no more than NCPU of them.
+  bench(1);
+  bench(NCPU / 2);
+  return 0;
+}
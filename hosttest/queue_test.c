@@ -0,0 +1,163 @@
+// Tests and a handoff benchmark for kernel/util/queue.c, run on the
+// host by make hosttest.
+
+#include <sched.h>
+
+#include "hosttest/check.h"
+#include "kernel/util/queue.h"
+
+struct rec {
+  int producer;
+  int n;
+  char pad[24];  // wider than a word, so torn copies show up
+};
+
+static void test_basic(void) {
+  struct spsc s;
+  struct mpsc m;
+  char sbuf[4];
+  uint64 mbuf[4];
+  uint seq[4];
+  char c;
+  uint64 x;
+
+  spsc_init(&s, sbuf, 1, 4);
+  CHECK(spsc_pop(&s, &c) < 0 && spsc_peek(&s, &c) < 0);
+  for (c = 'a'; c < 'e'; c++) CHECK(spsc_push(&s, &c) == 0);
+  CHECK(spsc_push(&s, &c) < 0);
+  CHECK(spsc_count(&s) == 4);
+  CHECK(spsc_peek(&s, &c) == 0 && c == 'a');
+  CHECK(spsc_pop(&s, &c) == 0 && c == 'a');
+  c = 'e';
+  CHECK(spsc_push(&s, &c) == 0);
+  for (char want = 'b'; want <= 'e'; want++)
+    CHECK(spsc_pop(&s, &c) == 0 && c == want);
+  CHECK(spsc_pop(&s, &c) < 0);
+
+  mpsc_init(&m, mbuf, seq, sizeof(uint64), 4);
+  CHECK(mpsc_pop(&m, &x) < 0 && !mpsc_ready(&m));
+  // Go around the ring a few times.
+  for (uint64 i = 0; i < 20; i++) {
+    CHECK(mpsc_push(&m, &i) == 0 && mpsc_ready(&m));
+    if (i % 4 == 3) {
+      CHECK(mpsc_count(&m) == 4);
+      CHECK(mpsc_push(&m, &i) < 0);
+      for (uint64 j = i - 3; j <= i; j++)
+        CHECK(mpsc_pop(&m, &x) == 0 && x == j);
+      CHECK(mpsc_pop(&m, &x) < 0);
+    }
+  }
+
+  // A slot claimed by a producer that hasn't filled it in yet.
+  m.head++;
+  CHECK(mpsc_count(&m) == 1 && !mpsc_ready(&m) && mpsc_pop(&m, &x) < 0);
+  mbuf[m.tail & m.mask] = 42;
+  m.seq[m.tail & m.mask] = m.tail + 1;
+  CHECK(mpsc_ready(&m) && mpsc_pop(&m, &x) == 0 && x == 42);
+}
+
+// One producer and one consumer hand over a numbered stream through a
+// small ring, so both wrap and hit full and empty often.
+enum { N = 1000000, NPROD = 4 };
+static struct spsc sq;
+static struct rec sbuf[16];
+
+static void *spsc_producer(void *arg) {
+  struct rec r = {0};
+  for (r.n = 0; r.n < N; r.n++)
+    while (spsc_push(&sq, &r) < 0) sched_yield();
+  return 0;
+}
+
+static void test_spsc(void) {
+  pthread_t p;
+  struct rec r;
+
+  spsc_init(&sq, sbuf, sizeof(struct rec), 16);
+  pthread_create(&p, 0, spsc_producer, 0);
+  for (int i = 0; i < N; i++) {
+    while (spsc_pop(&sq, &r) < 0) sched_yield();
+    CHECK(r.n == i);
+  }
+  pthread_join(p, 0);
+  CHECK(spsc_count(&sq) == 0);
+}
+
+// Several producers push their own numbered streams; the consumer
+// sees each stream in order, and all of it.
+static struct mpsc mq;
+static struct rec mbuf[16];
+static uint mseq[16];
+
+static void *mpsc_producer(void *arg) {
+  struct rec r = {.producer = (long)arg};
+  for (r.n = 0; r.n < N / NPROD; r.n++)
+    while (mpsc_push(&mq, &r) < 0) sched_yield();
+  return 0;
+}
+
+static void test_mpsc(void) {
+  pthread_t p[NPROD];
+  int next[NPROD] = {0};
+  struct rec r;
+
+  mpsc_init(&mq, mbuf, mseq, sizeof(struct rec), 16);
+  for (long i = 0; i < NPROD; i++)
+    pthread_create(&p[i], 0, mpsc_producer, (void *)i);
+  for (int got = 0; got < N / NPROD * NPROD; got++) {
+    while (mpsc_pop(&mq, &r) < 0) sched_yield();
+    CHECK(r.producer >= 0 && r.producer < NPROD);
+    CHECK(r.n == next[r.producer]);
+    next[r.producer] = r.n + 1;
+  }
+  for (int i = 0; i < NPROD; i++) pthread_join(p[i], 0);
+  CHECK(mpsc_pop(&mq, &r) < 0);
+}
+
+// Push and pop from one thread, against a ring under a mutex.
+static void bench(void) {
+  enum { OPS = 10000000 };
+  static char buf[64], lbuf[64];
+  static uint seq[64];
+  pthread_mutex_t mu = PTHREAD_MUTEX_INITIALIZER;
+  struct spsc s;
+  struct mpsc m;
+  uint r = 0, w = 0;
+  char c = 'x';
+
+  spsc_init(&s, buf, 1, 64);
+  mpsc_init(&m, buf, seq, 1, 64);
+  double t0 = now();
+  for (int i = 0; i < OPS; i++) {
+    spsc_push(&s, &c);
+    spsc_pop(&s, &c);
+  }
+  double t1 = now();
+  for (int i = 0; i < OPS; i++) {
+    mpsc_push(&m, &c);
+    mpsc_pop(&m, &c);
+  }
+  double t2 = now();
+  for (int i = 0; i < OPS; i++) {
+    pthread_mutex_lock(&mu);
+    if (w - r < 64) lbuf[w++ % 64] = c;
+    pthread_mutex_unlock(&mu);
+    pthread_mutex_lock(&mu);
+    if (r != w) c = lbuf[r++ % 64];
+    pthread_mutex_unlock(&mu);
+  }
+  double t3 = now();
+  printf("queue_test: push+pop: spsc %4.1f ns, mpsc %4.1f ns, "
+         "locked %4.1f ns\n",
+         (t1 - t0) / OPS, (t2 - t1) / OPS, (t3 - t2) / OPS);
+}
+
+int main(int argc, char *argv[]) {
+  test_basic();
+  test_spsc();
+  test_mpsc();
+  if (report("queue_test")) return 1;
+
+  bench();
+  return 0;
+}
@@ -0,0 +1,166 @@
+// Tests and an insert benchmark for kernel/util/vector.c, run on the
+// host by make hosttest.
+
+#include <stdlib.h>
+
+#include "hosttest/check.h"
+#include "kernel/util/epoch.h"
+#include "kernel/util/vector.h"
+
+// The scan v_replace_first_zero() used to do.
+static int linear_first_zero(struct vector *v) {
+  int i = 0;
+  for (; i < v->size; i++)
+    if (v_get(v, i) == 0) break;
+  return i;
+}
+
+static void test_basic(void) {
+  struct vector v;
+
+  v_init(&v);
+  for (int i = 0; i < 100; i++) CHECK(v_replace_first_zero(&v, i + 1) == i);
+  v_set(&v, 70, 0);
+  v_set(&v, 5, 0);
+  v_set(&v, 64, 0);
+  CHECK(v_replace_first_zero(&v, 1) == 5);
+  CHECK(v_replace_first_zero(&v, 1) == 64);
+  CHECK(v_replace_first_zero(&v, 1) == 70);
+  CHECK(v_replace_first_zero(&v, 1) == 100);
+  CHECK(v_get(&v, 101) == 0 && v_get(&v, 1 << 20) == 0);
+
+  CHECK(v_push_back(&v, 0) == 0);
+  CHECK(v_replace_first_zero(&v, 7) == 101);
+  CHECK(v_pop_back(&v) == 7);
+  CHECK(v_pop_back(&v) == 1);
+  CHECK(v.size == 100);
+  v_clear(&v);
+  CHECK(v_replace_first_zero(&v, 1) == 0);
+  v_clear(&v);
+  epoch_poll();
+}
+
+// Random sets, pushes, pops and compactions against the linear scan.
+static void test_random(void) {
+  struct vector v;
+
+  v_init(&v);
+  srand(2);
+  for (int i = 0; i < 200000; i++) {
+    int op = rand() % 16;
+    if (op < 7) {
+      int want = linear_first_zero(&v);
+      CHECK(v_replace_first_zero(&v, i + 1) == want);
+    } else if (op < 14 && v.size > 0) {
+      v_set(&v, rand() % v.size, 0);
+    } else if (op == 14 && v.size > 0) {
+      v_pop_back(&v);
+    } else {
+      int n = v.size;
+      while (n > 0 && v_get(&v, n - 1) == 0) n--;
+      v_compact(&v);
+      CHECK(v.size == n);
+      CHECK(v.capacity <= 4 || v.size > v.capacity / 4);
+    }
+  }
+  v_clear(&v);
+  epoch_poll();
+}
+
+// After a spike, compaction brings the slots to scan and the storage
+// back down, without moving the slots still in use.
+static void test_spike(void) {
+  enum { N = 10000 };
+  struct vector v;
+
+  v_init(&v);
+  for (int i = 0; i < N; i++) v_replace_first_zero(&v, i + 1);
+  for (int i = 3; i < N; i++) {
+    v_set(&v, i, 0);
+    v_compact(&v);
+  }
+  v_set(&v, 1, 0);
+  v_compact(&v);
+  CHECK(v.size == 3);
+  CHECK(v.capacity == 8);
+  CHECK(v_get(&v, 0) == 1 && v_get(&v, 1) == 0 && v_get(&v, 2) == 3);
+  CHECK(v_replace_first_zero(&v, 9) == 1);
+  v_clear(&v);
+  epoch_poll();
+}
+
+// Readers keep walking up to a size they loaded earlier while the
+// writer grows and compacts the vector under them.
+static struct vector shared;
+
+static void *reader(void *arg) {
+  while (!done()) {
+    int n = __atomic_load_n(&shared.size, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < n; i++) {
+      uint64 x = v_get(&shared, i);
+      CHECK(x == 0 || x == i + 1);
+    }
+  }
+  return 0;
+}
+
+static void test_concurrent(void) {
+  pthread_t r[2];
+
+  v_init(&shared);
+  bg_start(r, 2, reader);
+  for (int round = 0; round < 200; round++) {
+    for (int i = 0; i < 1000; i++) v_replace_first_zero(&shared, i + 1);
+    for (int i = 999; i >= 0; i--) {
+      v_set(&shared, i, 0);
+      v_compact(&shared);
+    }
+  }
+  bg_stop(r, 2);
+  v_clear(&shared);
+  epoch_poll();
+}
+
+// fork()/exit() churn with n live processes: free a random slot and
+// fill the lowest free one, against the old linear scan.
+static void bench(int n) {
+  enum { OPS = 100000 };
+  struct vector v;
+  volatile long sink = 0;
+
+  v_init(&v);
+  for (int i = 0; i < n; i++) v_replace_first_zero(&v, i + 1);
+
+  srand(1);
+  double t0 = now();
+  for (int i = 0; i < OPS; i++) {
+    v_set(&v, rand() % n, 0);
+    sink += v_replace_first_zero(&v, 1);
+  }
+  double t1 = now();
+  for (int i = 0; i < OPS; i++) {
+    int pos = rand() % n;
+    v_set(&v, pos, 0);
+    sink += linear_first_zero(&v);
+    v_set(&v, pos, 1);
+  }
+  double t2 = now();
+
+  printf("vector_test: %6d slots: bitmap %6.1f ns, linear scan %8.1f ns\n", n,
+         (t1 - t0) / OPS, (t2 - t1) / OPS);
+  v_clear(&v);
+  epoch_poll();
+}
+
+int main(int argc, char *argv[]) {
+  test_basic();
+  test_random();
+  test_spike();
+  test_concurrent();
+  if (report("vector_test")) return 1;
+
+  bench(64);
+  bench(1000);
+  bench(10000);
+  return 0;
+}
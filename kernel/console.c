@@ -15,6 +15,7 @@
 #include "fs/file.h"
 #include "proc/proc.h"
 #include "types.h"
+#include "util/queue.h"
 
 #define BACKSPACE 0x100
 #define C(x) ((x) - '@')  // Control-x
@@ -47,15 +48,19 @@ void console_write_char(int c) {
   }
 }
 
+// Input. consoleintr() edits the current line in line[],
+// then hands it over to consoleread() through in.
 struct {
-  struct spinlock lock;
+  struct spinlock lock;  // serializes consoleintr()
 
-  // input
 #define INPUT_BUF_SIZE 128
-  char buf[INPUT_BUF_SIZE];
-  uint r;  // Read index
-  uint w;  // Write index
+  char line[INPUT_BUF_SIZE];
   uint e;  // Edit index
+
+  struct spsc in;
+  char in_buf[INPUT_BUF_SIZE];
+  struct spinlock read_lock;  // serializes consoleread()
+  int waiting;                // readers sleeping on in
 } cons;
 
 //
@@ -85,28 +90,33 @@ int consoleread(int user_dst, uint64 dst, int n) {
   char cbuf;
 
   target = n;
-  acquire(&cons.lock);
+  acquire(&cons.read_lock);
   while (n > 0) {
     // wait until interrupt handler has put some
-    // input into cons.buffer.
-    while (cons.r == cons.w) {
+    // input into cons.in. it only takes read_lock
+    // to wake us if it sees us waiting, so look
+    // again after saying so.
+    if (spsc_peek(&cons.in, &cbuf) < 0) {
       if (killed(myproc())) {
-        release(&cons.lock);
+        release(&cons.read_lock);
         return -1;
       }
-      sleep(&cons.r, &cons.lock);
+      __atomic_fetch_add(&cons.waiting, 1, __ATOMIC_SEQ_CST);
+      if (spsc_count(&cons.in) == 0) sleep(&cons.in, &cons.read_lock);
+      __atomic_fetch_sub(&cons.waiting, 1, __ATOMIC_RELAXED);
+      continue;
     }
-
-    c = cons.buf[cons.r++ % INPUT_BUF_SIZE];
+    c = cbuf;
 
     if (c == C('D')) {  // end-of-file
-      if (n < target) {
-        // Save ^D for next time, to make sure
+      if (n == target) {
+        // Otherwise save ^D for next time, to make sure
         // caller gets a 0-byte result.
-        cons.r--;
+        spsc_pop(&cons.in, &cbuf);
       }
       break;
     }
+    spsc_pop(&cons.in, &cbuf);
 
     // copy the input byte to the user-space buffer.
     cbuf = c;
@@ -121,16 +131,33 @@ int consoleread(int user_dst, uint64 dst, int n) {
       break;
     }
   }
-  release(&cons.lock);
+  release(&cons.read_lock);
 
   return target - n;
 }
 
+//
+// hand the edited line over to consoleread(),
+// and wake it up if it's waiting.
+//
+static void consolecommit(void) {
+  // consoleintr() left room for the whole line.
+  for (uint i = 0; i < cons.e; i++) spsc_push(&cons.in, &cons.line[i]);
+  cons.e = 0;
+
+  __sync_synchronize();
+  if (__atomic_load_n(&cons.waiting, __ATOMIC_RELAXED)) {
+    acquire(&cons.read_lock);
+    wakeup(&cons.in);
+    release(&cons.read_lock);
+  }
+}
+
 //
 // the console input interrupt handler.
 // uartintr() calls this for input character.
-// do erase/kill processing, append to cons.buf,
-// wake up consoleread() if a whole line has arrived.
+// do erase/kill processing, append to cons.line,
+// hand it to consoleread() if a whole line has arrived.
 //
 void consoleintr(int c) {
   acquire(&cons.lock);
@@ -140,34 +167,33 @@ void consoleintr(int c) {
       procdump();
       break;
     case C('U'):  // Kill line.
-      while (cons.e != cons.w &&
-             cons.buf[(cons.e - 1) % INPUT_BUF_SIZE] != '\n') {
+      while (cons.e != 0) {
         cons.e--;
         consputc(BACKSPACE);
       }
       break;
     case C('H'):  // Backspace
     case '\x7f':  // Delete key
-      if (cons.e != cons.w) {
+      if (cons.e != 0) {
         cons.e--;
         consputc(BACKSPACE);
       }
       break;
     default:
-      if (c != 0 && cons.e - cons.r < INPUT_BUF_SIZE) {
+      // consoleread() only ever makes more room in cons.in.
+      if (c != 0 && cons.e + spsc_count(&cons.in) < INPUT_BUF_SIZE) {
         c = (c == '\r') ? '\n' : c;
 
         // echo back to the user.
         consputc(c);
 
         // store for consumption by consoleread().
-        cons.buf[cons.e++ % INPUT_BUF_SIZE] = c;
+        cons.line[cons.e++] = c;
 
-        if (c == '\n' || c == C('D') || cons.e - cons.r == INPUT_BUF_SIZE) {
-          // wake up consoleread() if a whole line (or end-of-file)
-          // has arrived.
-          cons.w = cons.e;
-          wakeup(&cons.r);
+        if (c == '\n' || c == C('D') ||
+            cons.e + spsc_count(&cons.in) == INPUT_BUF_SIZE) {
+          // a whole line (or end-of-file) has arrived.
+          consolecommit();
         }
       }
       break;
@@ -178,6 +204,8 @@ void consoleintr(int c) {
 
 void consoleinit(void) {
   initlock(&cons.lock, "cons");
+  initlock(&cons.read_lock, "cons read");
+  spsc_init(&cons.in, cons.in_buf, 1, INPUT_BUF_SIZE);
 
   uartinit();
 
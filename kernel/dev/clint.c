@@ -0,0 +1,56 @@
+//
+// the riscv Core Local Interruptor (CLINT).
+//
+
+#include "clint.h"
+
+#include "../mem/memlayout.h"
+#include "../proc/proc.h"
+
+// raise a machine-mode software interrupt on hart.
+// timervec in kernelvec.S turns it into a supervisor
+// software interrupt, which wakes the hart from wfi.
+void clint_send_ipi(int hart) {
+  __sync_synchronize();
+  *(volatile uint32 *)CLINT_MSIP(hart) = 1;
+}
+
+// did timervec forward a clock tick to this hart since the last call?
+// otherwise the supervisor software interrupt was an IPI.
+// interrupts must be disabled.
+int clint_tick_pending(void) {
+  return __sync_lock_test_and_set(&timer_scratch[cpuid()][5], 0) != 0;
+}
+
+// ask for a timer interrupt on this hart once the time CSR reaches t,
+// besides the clock ticks; -1 for none. replaces the previous deadline.
+// interrupts must be disabled.
+void clint_set_deadline(uint64 t) {
+  int id = cpuid();
+  uint64 *scratch = timer_scratch[id];
+
+  scratch[8] = t;
+  // timervec only looks at the deadline when it runs, which could be
+  // a whole tick away.
+  if (t < scratch[7]) clint_send_ipi(id);
+}
+
+// set the time of this hart's next clock tick; -1 turns its clock
+// ticks off. interrupts must be disabled.
+void clint_set_tick(uint64 t) {
+  int id = cpuid();
+
+  timer_scratch[id][7] = t;
+  // have timervec reprogram mtimecmp now, which may be set far off.
+  if (t != -1) clint_send_ipi(id);
+}
+
+// time between clock ticks, in CLINT_MTIME cycles.
+uint64 clint_interval(void) { return timer_scratch[0][4]; }
+
+// change the time between clock ticks on all harts, starting
+// with each one's next tick.
+void clint_set_interval(uint64 interval) {
+  for (int i = 0; i < NCPU; i++)
+    __atomic_store_n(&timer_scratch[i][4], interval, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "../param.h"
+#include "../types.h"
+
+// per-hart scratch area shared with timervec in kernelvec.S,
+// see timerinit() in start.c for the layout.
+extern uint64 timer_scratch[NCPU][10];
+
+void clint_send_ipi(int hart);
+int clint_tick_pending(void);
+void clint_set_deadline(uint64 t);
+void clint_set_tick(uint64 t);
+uint64 clint_interval(void);
+void clint_set_interval(uint64 interval);
@@ -5,9 +5,11 @@
 #include "uart.h"
 
 #include "../console.h"
+#include "../kmsg.h"
 #include "../mem/memlayout.h"
 #include "../proc/proc.h"
 #include "../types.h"
+#include "../util/queue.h"
 #include "../util/spinlock.h"
 
 // the UART control registers are memory-mapped
@@ -38,17 +40,19 @@
 #define ReadReg(reg) (*(Reg(reg)))
 #define WriteReg(reg, v) (*(Reg(reg)) = (v))
 
-// the transmit output buffer.
-struct spinlock uart_tx_lock;
+// the transmit output buffer. write()s on any hart add to it
+// without a lock; whichever hart holds uart_tx_busy feeds the
+// UART from it. uart_tx_lock is only for sleeping while it's full.
 #define UART_TX_BUF_SIZE 32
 char uart_tx_buf[UART_TX_BUF_SIZE];
-uint64 uart_tx_w;  // write next to uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE]
-uint64 uart_tx_r;  // read next from uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]
+uint uart_tx_seq[UART_TX_BUF_SIZE];
+struct mpsc uart_tx;
+int uart_tx_busy;     // is a hart feeding the UART?
+int uart_tx_waiting;  // processes sleeping in uartputc()
+struct spinlock uart_tx_lock;
 
 extern volatile int panicked;  // from printf.c
 
-void uartstart();
-
 void uartinit(void) {
   // disable interrupts.
   WriteReg(IER, 0x00);
@@ -72,6 +76,7 @@ void uartinit(void) {
   // enable transmit and receive interrupts.
   WriteReg(IER, IER_TX_ENABLE | IER_RX_ENABLE);
 
+  mpsc_init(&uart_tx, uart_tx_buf, uart_tx_seq, 1, UART_TX_BUF_SIZE);
   initlock(&uart_tx_lock, "uart");
 }
 
@@ -82,21 +87,25 @@ void uartinit(void) {
 // from interrupts; it's only suitable for use
 // by write().
 void uartputc(int c) {
-  acquire(&uart_tx_lock);
+  char ch = c;
 
   if (panicked) {
     for (;;)
       ;
   }
-  while (uart_tx_w == uart_tx_r + UART_TX_BUF_SIZE) {
+  while (mpsc_push(&uart_tx, &ch) < 0) {
     // buffer is full.
     // wait for uartstart() to open up space in the buffer.
-    sleep(&uart_tx_r, &uart_tx_lock);
+    // it only takes the lock to wake us if it sees us
+    // waiting, so look again after saying so.
+    acquire(&uart_tx_lock);
+    __atomic_fetch_add(&uart_tx_waiting, 1, __ATOMIC_SEQ_CST);
+    if (mpsc_count(&uart_tx) >= UART_TX_BUF_SIZE)
+      sleep(&uart_tx, &uart_tx_lock);
+    __atomic_fetch_sub(&uart_tx_waiting, 1, __ATOMIC_RELAXED);
+    release(&uart_tx_lock);
   }
-  uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE] = c;
-  uart_tx_w += 1;
   uartstart();
-  release(&uart_tx_lock);
 }
 
 // alternate version of uartputc() that doesn't
@@ -119,34 +128,61 @@ void uartputc_sync(int c) {
   pop_off();
 }
 
-// if the UART is idle, and a character is waiting
-// in the transmit buffer, send it.
-// caller must hold uart_tx_lock.
-// called from both the top- and bottom-half.
-void uartstart() {
-  while (1) {
-    if (uart_tx_w == uart_tx_r) {
-      // transmit buffer is empty.
-      return;
-    }
+// next character to send, the kernel log's before
+// write()s'. returns -1 if there's none.
+static int uartnext(char *c) {
+  int k = kmsg_getc();
+  if (k >= 0) {
+    *c = k;
+    return 0;
+  }
+  return mpsc_pop(&uart_tx, c);
+}
 
-    if ((ReadReg(LSR) & LSR_TX_IDLE) == 0) {
-      // the UART transmit holding register is full,
-      // so we cannot give it another byte.
-      // it will interrupt when it's ready for a new byte.
-      return;
-    }
+// if the UART is idle, and characters are waiting
+// in the kernel log or the transmit buffer, send them.
+// called from both the top- and bottom-half, on any hart.
+// if another hart is at it already, leave it to that one.
+// wake says whether it may wake up uartputc() callers;
+// without it, the next call with it will.
+static void uartdrain(int wake) {
+  char c;
 
-    int c = uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE];
-    uart_tx_r += 1;
+  push_off();
+  do {
+    if (__atomic_exchange_n(&uart_tx_busy, 1, __ATOMIC_SEQ_CST)) break;
+
+    // stop when the buffer is empty, or when the UART transmit
+    // holding register is full, so we cannot give it another
+    // byte; it will interrupt when it's ready for a new one.
+    while ((ReadReg(LSR) & LSR_TX_IDLE) && uartnext(&c) == 0)
+      WriteReg(THR, c);
+    __atomic_store_n(&uart_tx_busy, 0, __ATOMIC_SEQ_CST);
 
     // maybe uartputc() is waiting for space in the buffer.
-    wakeup(&uart_tx_r);
+    __sync_synchronize();
+    if (wake && __atomic_load_n(&uart_tx_waiting, __ATOMIC_RELAXED) &&
+        mpsc_count(&uart_tx) < UART_TX_BUF_SIZE) {
+      acquire(&uart_tx_lock);
+      wakeup(&uart_tx);
+      release(&uart_tx_lock);
+    }
 
-    WriteReg(THR, c);
-  }
+    // a character added meanwhile may have found this hart
+    // busy and been left to it.
+  } while ((ReadReg(LSR) & LSR_TX_IDLE) &&
+           (kmsg_pending() || mpsc_ready(&uart_tx)));
+  pop_off();
 }
 
+void uartstart(void) { uartdrain(1); }
+
+// for printf(), whose caller may hold any lock, so
+// it mustn't wake up processes. once the UART has
+// sent what this gives it, it interrupts, and
+// uartintr() does the waking.
+void uartkick(void) { uartdrain(0); }
+
 // read one input character from the UART.
 // return -1 if none is waiting.
 int uartgetc(void) {
@@ -170,7 +206,5 @@ void uartintr(void) {
   }
 
   // send buffered characters.
-  acquire(&uart_tx_lock);
   uartstart();
-  release(&uart_tx_lock);
 }
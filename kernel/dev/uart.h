@@ -4,4 +4,6 @@ void uartinit(void);
 void uartintr(void);
 void uartputc(int);
 void uartputc_sync(int);
+void uartstart(void);
+void uartkick(void);
 int uartgetc(void);
\ No newline at end of file
@@ -0,0 +1,35 @@
+// Kernel event counters, see events.h.
+
+#include "events.h"
+
+#include "fs/file.h"
+#include "proc/proc.h"
+
+struct percpu_counter events[NEVENT];
+
+// Copy out as many whole counters as fit in n bytes.
+static int eventsread(int user_dst, uint64 dst, int n) {
+  int i;
+
+  for (i = 0; i < NEVENT && (i + 1) * sizeof(uint64) <= n; i++) {
+    uint64 v = percpu_counter_sum(&events[i]);
+    if (either_copyout(user_dst, dst + i * sizeof(v), &v, sizeof(v)) < 0)
+      return -1;
+  }
+  return i * sizeof(uint64);
+}
+
+// Any write resets the counters. A hart counting meanwhile may keep
+// its old count.
+static int eventswrite(int user_src, uint64 src, int n) {
+  for (int i = 0; i < NEVENT; i++)
+    percpu_counter_init(&events[i], 0, PERCPU_NOFOLD);
+  return n;
+}
+
+void eventsinit(void) {
+  for (int i = 0; i < NEVENT; i++)
+    percpu_counter_init(&events[i], 0, PERCPU_NOFOLD);
+  devsw[EVENTS].read = eventsread;
+  devsw[EVENTS].write = eventswrite;
+}
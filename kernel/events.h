@@ -0,0 +1,21 @@
+#pragma once
+
+#include "util/percpu.h"
+
+// Kernel event counters, read from the EVENTS device as an array of
+// NEVENT uint64 indexed by EV_*. Writing anything resets them.
+
+#define EV_FORK 0     // Processes and threads created
+#define EV_SWITCH 1   // Processes switched to by scheduler()
+#define EV_SYSCALL 2  // System calls
+#define EV_DEVINTR 3  // Device interrupts through the PLIC
+#define EV_TICK 4     // Clock ticks
+#define EV_IPI 5      // Interrupts from other harts
+#define EV_KALLOC 6   // Pages handed out by kalloc()
+#define NEVENT 7
+
+extern struct percpu_counter events[NEVENT];
+
+#define count_event(e) percpu_counter_add(&events[e], 1)
+
+void eventsinit(void);
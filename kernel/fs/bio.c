@@ -40,7 +40,7 @@ void binit(void) {
   for (b = bcache.buf; b < bcache.buf + NBUF; b++) {
     b->next = bcache.head.next;
     b->prev = &bcache.head;
-    initsleeplock(&b->lock, "buffer");
+    initsleeplock_adaptive(&b->lock, "buffer");
     bcache.head.next->prev = b;
     bcache.head.next = b;
   }
@@ -66,10 +66,10 @@ int filestat(struct file *f, uint64 addr) {
   struct stat st;
 
   if (f->type == FD_INODE || f->type == FD_DEVICE) {
-    ilock(f->ip);
+    ilock_shared(f->ip);
     stati(f->ip, &st);
     iunlock(f->ip);
-    if (copyout(p->pagetable, addr, (char *)&st, sizeof(st)) < 0) return -1;
+    if (copyout(p->tg->pagetable, addr, (char *)&st, sizeof(st)) < 0) return -1;
     return 0;
   }
   return -1;
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../util/sleeplock.h"
+#include "../util/rwsem.h"
 
 // Remember to change this constant in fs.h too
 #define NDIRECT 12
@@ -27,7 +27,7 @@ struct inode {
   uint dev;               // Device number
   uint inum;              // Inode number
   int ref;                // Reference count
-  struct sleeplock lock;  // protects everything below here
+  struct rwsem lock;      // protects everything below here
   int valid;              // inode has been read from disk?
 
   short type;  // copy of disk inode
@@ -47,10 +47,17 @@ struct devsw {
 extern struct devsw devsw[];
 
 #define CONSOLE 1
+#define SYSSTAT 2
+#define STRACE 3
+#define PROF 4
+#define LOCKSTAT 5
+#define EVENTS 6
+#define KMSG 7
 
 struct file* filealloc(void);
 void fileclose(struct file*);
 struct file* filedup(struct file*);
+struct file* fileopen(char*, int);
 void fileinit(void);
 int fileread(struct file*, uint64, int n);
 int filestat(struct file*, uint64 addr);
@@ -157,9 +157,11 @@ static void bfree(int dev, uint b) {
 // and ip->dev and ip->inum indicate which i-node an entry
 // holds, one must hold itable.lock while using any of those fields.
 //
-// An ip->lock sleep-lock protects all ip-> fields other than ref,
+// An ip->lock rwsem protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
+// Holding it shared (ilock_shared) allows reading them, and the
+// inode's contents, alongside other readers.
 
 struct {
   struct spinlock lock;
@@ -171,7 +173,7 @@ void iinit() {
 
   initlock(&itable.lock, "itable");
   for (i = 0; i < NINODE; i++) {
-    initsleeplock(&itable.inode[i].lock, "inode");
+    initrwsem(&itable.inode[i].lock, "inode");
   }
 }
 
@@ -272,7 +274,7 @@ void ilock(struct inode *ip) {
 
   if (ip == 0 || ip->ref < 1) panic("ilock");
 
-  acquiresleep(&ip->lock);
+  rwsem_acquire_write(&ip->lock);
 
   if (ip->valid == 0) {
     bp = bread(ip->dev, IBLOCK(ip->inum, sb));
@@ -289,11 +291,36 @@ void ilock(struct inode *ip) {
   }
 }
 
-// Unlock the given inode.
-void iunlock(struct inode *ip) {
-  if (ip == 0 || !holdingsleep(&ip->lock) || ip->ref < 1) panic("iunlock");
+// Lock the given inode for reading only, alongside other readers.
+// Reads the inode from disk if necessary.
+void ilock_shared(struct inode *ip) {
+  if (ip == 0 || ip->ref < 1) panic("ilock_shared");
+
+  rwsem_acquire_read(&ip->lock);
+  if (!ip->valid) {
+    // Load it with the lock held exclusively. Our reference keeps it
+    // valid after that.
+    rwsem_release_read(&ip->lock);
+    ilock(ip);
+    iunlock(ip);
+    rwsem_acquire_read(&ip->lock);
+  }
+  myproc()->ishared++;
+}
 
-  releasesleep(&ip->lock);
+// Unlock the given inode, locked with ilock() or ilock_shared().
+void iunlock(struct inode *ip) {
+  if (ip == 0 || ip->ref < 1) panic("iunlock");
+
+  if (rwsem_holding_write(&ip->lock)) {
+    rwsem_release_write(&ip->lock);
+  } else {
+    // Can't tell which readers are which, but we must be one.
+    struct proc *p = myproc();
+    if (p->ishared < 1 || ip->lock.readers < 1) panic("iunlock");
+    p->ishared--;
+    rwsem_release_read(&ip->lock);
+  }
 }
 
 // Drop a reference to an in-memory inode.
@@ -310,8 +337,8 @@ void iput(struct inode *ip) {
     // inode has no links and no other references: truncate and free.
 
     // ip->ref == 1 means no other process can have ip locked,
-    // so this acquiresleep() won't block (or deadlock).
-    acquiresleep(&ip->lock);
+    // so this rwsem_acquire_write() won't block (or deadlock).
+    rwsem_acquire_write(&ip->lock);
 
     release(&itable.lock);
 
@@ -320,7 +347,7 @@ void iput(struct inode *ip) {
     iupdate(ip);
     ip->valid = 0;
 
-    releasesleep(&ip->lock);
+    rwsem_release_write(&ip->lock);
 
     acquire(&itable.lock);
   }
@@ -581,10 +608,10 @@ static struct inode *namex(char *path, int nameiparent, char *name) {
   if (*path == '/')
     ip = iget(ROOTDEV, ROOTINO);
   else
-    ip = idup(myproc()->cwd);
+    ip = idup(myproc()->tg->cwd);
 
   while ((path = skipelem(path, name)) != 0) {
-    ilock(ip);
+    ilock_shared(ip);
     if (ip->type != T_DIR) {
       iunlockput(ip);
       return 0;
@@ -70,6 +70,7 @@ struct inode* ialloc(uint, short);
 struct inode* idup(struct inode*);
 void iinit();
 void ilock(struct inode*);
+void ilock_shared(struct inode*);
 void iput(struct inode*);
 void iunlock(struct inode*);
 void iunlockput(struct inode*);
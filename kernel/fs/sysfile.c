@@ -15,19 +15,29 @@
 #include "../printf.h"
 #include "../proc/exec.h"
 #include "../proc/proc.h"
+#include "../proc/spawn.h"
 #include "../syscall.h"
 #include "../util/string.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
-// and return both the descriptor and the corresponding struct file.
-static int argfd(int n, int *pfd, struct file **pf) {
+// and return the corresponding struct file with a reference held, so
+// that another thread closing the descriptor can't free it under us.
+// The caller drops the reference with fileclose().
+static int argfd(int n, struct file **pf) {
   int fd;
   struct file *f;
+  struct tgroup *tg = myproc()->tg;
 
   argint(n, &fd);
-  if (fd < 0 || fd >= NOFILE || (f = myproc()->ofile[fd]) == 0) return -1;
-  if (pfd) *pfd = fd;
-  if (pf) *pf = f;
+  if (fd < 0 || fd >= NOFILE) return -1;
+  acquire(&tg->lock);
+  if ((f = tg->ofile[fd]) == 0) {
+    release(&tg->lock);
+    return -1;
+  }
+  filedup(f);
+  release(&tg->lock);
+  *pf = f;
   return 0;
 }
 
@@ -35,14 +45,18 @@ static int argfd(int n, int *pfd, struct file **pf) {
 // Takes over file reference from caller on success.
 static int fdalloc(struct file *f) {
   int fd;
-  struct proc *p = myproc();
+  struct tgroup *tg = myproc()->tg;
 
+  // Other threads may be allocating too.
+  acquire(&tg->lock);
   for (fd = 0; fd < NOFILE; fd++) {
-    if (p->ofile[fd] == 0) {
-      p->ofile[fd] = f;
+    if (tg->ofile[fd] == 0) {
+      tg->ofile[fd] = f;
+      release(&tg->lock);
       return fd;
     }
   }
+  release(&tg->lock);
   return -1;
 }
 
@@ -50,41 +64,55 @@ uint64 sys_dup(void) {
   struct file *f;
   int fd;
 
-  if (argfd(0, 0, &f) < 0) return -1;
-  if ((fd = fdalloc(f)) < 0) return -1;
-  filedup(f);
+  if (argfd(0, &f) < 0) return -1;
+  if ((fd = fdalloc(f)) < 0) {
+    fileclose(f);
+    return -1;
+  }
   return fd;
 }
 
 uint64 sys_read(void) {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
   argaddr(1, &p);
   argint(2, &n);
-  if (argfd(0, 0, &f) < 0) return -1;
-  return fileread(f, p, n);
+  if (argfd(0, &f) < 0) return -1;
+  r = fileread(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 uint64 sys_write(void) {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
   argaddr(1, &p);
   argint(2, &n);
-  if (argfd(0, 0, &f) < 0) return -1;
-
-  return filewrite(f, p, n);
+  if (argfd(0, &f) < 0) return -1;
+  r = filewrite(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 uint64 sys_close(void) {
   int fd;
   struct file *f;
-
-  if (argfd(0, &fd, &f) < 0) return -1;
-  myproc()->ofile[fd] = 0;
+  struct tgroup *tg = myproc()->tg;
+
+  argint(0, &fd);
+  if (fd < 0 || fd >= NOFILE) return -1;
+  // Only one of the threads closing fd at once gets to drop f.
+  acquire(&tg->lock);
+  if ((f = tg->ofile[fd]) == 0) {
+    release(&tg->lock);
+    return -1;
+  }
+  tg->ofile[fd] = 0;
+  release(&tg->lock);
   fileclose(f);
   return 0;
 }
@@ -92,10 +120,13 @@ uint64 sys_close(void) {
 uint64 sys_fstat(void) {
   struct file *f;
   uint64 st;  // user pointer to struct stat
+  int r;
 
   argaddr(1, &st);
-  if (argfd(0, 0, &f) < 0) return -1;
-  return filestat(f, st);
+  if (argfd(0, &f) < 0) return -1;
+  r = filestat(f, st);
+  fileclose(f);
+  return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -263,15 +294,11 @@ fail:
   return 0;
 }
 
-uint64 sys_open(void) {
-  char path[MAXPATH];
-  int fd, omode;
+// Open path with omode, returning a file not yet in any descriptor
+// table, or 0 on failure.
+struct file *fileopen(char *path, int omode) {
   struct file *f;
   struct inode *ip;
-  int n;
-
-  argint(1, &omode);
-  if ((n = argstr(0, path, MAXPATH)) < 0) return -1;
 
   begin_op();
 
@@ -279,32 +306,31 @@ uint64 sys_open(void) {
     ip = create(path, T_FILE, 0, 0);
     if (ip == 0) {
       end_op();
-      return -1;
+      return 0;
     }
   } else {
     if ((ip = namei(path)) == 0) {
       end_op();
-      return -1;
+      return 0;
     }
     ilock(ip);
     if (ip->type == T_DIR && omode != O_RDONLY) {
       iunlockput(ip);
       end_op();
-      return -1;
+      return 0;
     }
   }
 
   if (ip->type == T_DEVICE && (ip->major < 0 || ip->major >= NDEV)) {
     iunlockput(ip);
     end_op();
-    return -1;
+    return 0;
   }
 
-  if ((f = filealloc()) == 0 || (fd = fdalloc(f)) < 0) {
-    if (f) fileclose(f);
+  if ((f = filealloc()) == 0) {
     iunlockput(ip);
     end_op();
-    return -1;
+    return 0;
   }
 
   if (ip->type == T_DEVICE) {
@@ -325,6 +351,22 @@ uint64 sys_open(void) {
   iunlock(ip);
   end_op();
 
+  return f;
+}
+
+uint64 sys_open(void) {
+  char path[MAXPATH];
+  int fd, omode;
+  struct file *f;
+
+  argint(1, &omode);
+  if (argstr(0, path, MAXPATH) < 0) return -1;
+
+  if ((f = fileopen(path, omode)) == 0) return -1;
+  if ((fd = fdalloc(f)) < 0) {
+    fileclose(f);
+    return -1;
+  }
   return fd;
 }
 
@@ -377,47 +419,92 @@ uint64 sys_chdir(void) {
     return -1;
   }
   iunlock(ip);
-  iput(p->cwd);
+  iput(p->tg->cwd);
   end_op();
-  p->cwd = ip;
+  p->tg->cwd = ip;
   return 0;
 }
 
-uint64 sys_exec(void) {
-  char path[MAXPATH], *argv[MAXARG];
-  int i;
-  uint64 uargv, uarg;
+// Copy the user argv array at uargv into argv[MAXARG], one page per
+// string. Release it with freeargv(), even on failure.
+static int fetchargv(uint64 uargv, char **argv) {
+  uint64 uarg;
 
-  argaddr(1, &uargv);
-  if (argstr(0, path, MAXPATH) < 0) {
-    return -1;
-  }
-  memset(argv, 0, sizeof(argv));
-  for (i = 0;; i++) {
-    if (i >= NELEM(argv)) {
-      goto bad;
+  memset(argv, 0, sizeof(char *) * MAXARG);
+  for (int i = 0;; i++) {
+    if (i >= MAXARG) {
+      return -1;
     }
     if (fetchaddr(uargv + sizeof(uint64) * i, (uint64 *)&uarg) < 0) {
-      goto bad;
+      return -1;
     }
     if (uarg == 0) {
       argv[i] = 0;
-      break;
+      return 0;
     }
     argv[i] = kalloc();
-    if (argv[i] == 0) goto bad;
-    if (fetchstr(uarg, argv[i], PGSIZE) < 0) goto bad;
+    if (argv[i] == 0) return -1;
+    if (fetchstr(uarg, argv[i], PGSIZE) < 0) return -1;
   }
+}
 
-  int ret = exec(path, argv);
+static void freeargv(char **argv) {
+  for (int i = 0; i < MAXARG && argv[i] != 0; i++) kfree(argv[i]);
+}
 
-  for (i = 0; i < NELEM(argv) && argv[i] != 0; i++) kfree(argv[i]);
+uint64 sys_exec(void) {
+  char path[MAXPATH], *argv[MAXARG];
+  uint64 uargv;
+  int ret = -1;
 
+  argaddr(1, &uargv);
+  if (argstr(0, path, MAXPATH) < 0) {
+    return -1;
+  }
+  if (fetchargv(uargv, argv) == 0) ret = exec(path, argv);
+  freeargv(argv);
   return ret;
+}
 
-bad:
-  for (i = 0; i < NELEM(argv) && argv[i] != 0; i++) kfree(argv[i]);
-  return -1;
+uint64 sys_spawn(void) {
+  char path[MAXPATH], *argv[MAXARG];
+  struct spawn_action acts[SPAWN_MAXACTS];
+  struct file *files[SPAWN_MAXACTS];
+  uint64 uargv, uacts;
+  int nact, ret = -1;
+
+  argaddr(1, &uargv);
+  argaddr(2, &uacts);
+  argint(3, &nact);
+  if (nact < 0 || nact > SPAWN_MAXACTS) return -1;
+  if (argstr(0, path, MAXPATH) < 0) return -1;
+  if (copyin(myproc()->tg->pagetable, (char *)acts, uacts,
+             nact * sizeof(acts[0])) < 0)
+    return -1;
+
+  // Open files here, so the child is only created once they all exist.
+  memset(files, 0, sizeof(files));
+  for (int i = 0; i < nact; i++) {
+    struct spawn_action *a = &acts[i];
+    if (a->fd < 0 || a->fd >= NOFILE) goto out;
+    if (a->type == SPAWN_DUP2) {
+      if (a->newfd < 0 || a->newfd >= NOFILE) goto out;
+    } else if (a->type == SPAWN_OPEN) {
+      char opath[MAXPATH];
+      if (fetchstr((uint64)a->path, opath, MAXPATH) < 0) goto out;
+      if ((files[i] = fileopen(opath, a->omode)) == 0) goto out;
+    } else if (a->type != SPAWN_CLOSE) {
+      goto out;
+    }
+  }
+
+  if (fetchargv(uargv, argv) == 0) ret = spawn(path, argv, acts, files, nact);
+  freeargv(argv);
+
+out:
+  for (int i = 0; i < nact; i++)
+    if (files[i]) fileclose(files[i]);
+  return ret;
 }
 
 uint64 sys_pipe(void) {
@@ -430,16 +517,16 @@ uint64 sys_pipe(void) {
   if (pipealloc(&rf, &wf) < 0) return -1;
   fd0 = -1;
   if ((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0) {
-    if (fd0 >= 0) p->ofile[fd0] = 0;
+    if (fd0 >= 0) p->tg->ofile[fd0] = 0;
     fileclose(rf);
     fileclose(wf);
     return -1;
   }
-  if (copyout(p->pagetable, fdarray, (char *)&fd0, sizeof(fd0)) < 0 ||
-      copyout(p->pagetable, fdarray + sizeof(fd0), (char *)&fd1, sizeof(fd1)) <
-          0) {
-    p->ofile[fd0] = 0;
-    p->ofile[fd1] = 0;
+  if (copyout(p->tg->pagetable, fdarray, (char *)&fd0, sizeof(fd0)) < 0 ||
+      copyout(p->tg->pagetable, fdarray + sizeof(fd0), (char *)&fd1,
+              sizeof(fd1)) < 0) {
+    p->tg->ofile[fd0] = 0;
+    p->tg->ofile[fd1] = 0;
     fileclose(rf);
     fileclose(wf);
     return -1;
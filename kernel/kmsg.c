@@ -0,0 +1,114 @@
+// The kernel log, see kmsg.h.
+//
+// printf() appends to it, and uartkick() takes text out for the UART
+// with kmsg_getc() when the device is ready, so printing never waits
+// for the UART. Once the log wraps, the oldest text is gone, even if
+// the UART hadn't had it yet. panic() sends what's left with
+// kmsg_flush_sync(), then writes to the UART directly.
+
+#include "kmsg.h"
+
+#include "console.h"
+#include "fs/file.h"
+#include "proc/proc.h"
+#include "util/spinlock.h"
+
+// A zeroed lock works, so printf() may log before kmsginit().
+static struct {
+  struct spinlock lock;
+  char buf[KMSG_SIZE];
+  uint64 w;      // Bytes ever written
+  uint64 sent;   // Bytes the UART has had
+  int cr;        // Has the UART had the '\r' before buf[sent]?
+  uint64 start;  // Where reads start, since the last clear
+} kmsg;
+
+void kmsg_write(char *s, int n) {
+  acquire(&kmsg.lock);
+  for (int i = 0; i < n; i++) kmsg.buf[(kmsg.w + i) % KMSG_SIZE] = s[i];
+  __atomic_store_n(&kmsg.w, kmsg.w + n, __ATOMIC_RELEASE);
+  release(&kmsg.lock);
+}
+
+// Skip text that has been overwritten.
+static void skip_lost(uint64 *pos) {
+  if (kmsg.w - *pos > KMSG_SIZE) *pos = kmsg.w - KMSG_SIZE;
+}
+
+// The next character for the UART, with "\r\n" for newlines, or -1 if
+// it has had everything. Called by one hart at a time.
+int kmsg_getc(void) {
+  int c = -1;
+
+  acquire(&kmsg.lock);
+  if (kmsg.w - kmsg.sent > KMSG_SIZE) kmsg.cr = 0;
+  skip_lost(&kmsg.sent);
+  if (kmsg.sent != kmsg.w) {
+    c = kmsg.buf[kmsg.sent % KMSG_SIZE];
+    if (c == '\n' && !kmsg.cr) {
+      kmsg.cr = 1;
+      c = '\r';
+    } else {
+      kmsg.cr = 0;
+      __atomic_store_n(&kmsg.sent, kmsg.sent + 1, __ATOMIC_RELEASE);
+    }
+  }
+  release(&kmsg.lock);
+  return c;
+}
+
+// Is there text for the UART? Takes no lock.
+int kmsg_pending(void) {
+  return __atomic_load_n(&kmsg.w, __ATOMIC_ACQUIRE) !=
+         __atomic_load_n(&kmsg.sent, __ATOMIC_ACQUIRE);
+}
+
+// Send the rest of the log to the UART, spinning on it, for panic().
+// Doesn't lock: the lock's holder may be the hart that's panicking.
+void kmsg_flush_sync(void) {
+  skip_lost(&kmsg.sent);
+  for (; kmsg.sent != kmsg.w; kmsg.sent++)
+    consputc(kmsg.buf[kmsg.sent % KMSG_SIZE]);
+}
+
+// Copy out as much of the log as fits in n bytes, a piece at a time so
+// that printf() isn't held up by copyout().
+static int kmsgread(int user_dst, uint64 dst, int n) {
+  char piece[128];
+  uint64 pos, end;
+  int got = 0;
+
+  acquire(&kmsg.lock);
+  end = kmsg.w;
+  pos = kmsg.start;
+  skip_lost(&pos);
+  if (end - pos > n) pos = end - n;
+  release(&kmsg.lock);
+
+  for (;;) {
+    int m = 0;
+    acquire(&kmsg.lock);
+    skip_lost(&pos);  // Text overwritten meanwhile is lost.
+    if (pos < end) m = end - pos < sizeof(piece) ? end - pos : sizeof(piece);
+    for (int i = 0; i < m; i++) piece[i] = kmsg.buf[(pos + i) % KMSG_SIZE];
+    release(&kmsg.lock);
+    if (m == 0) break;
+    if (either_copyout(user_dst, dst + got, piece, m) < 0) return -1;
+    pos += m;
+    got += m;
+  }
+  return got;
+}
+
+static int kmsgwrite(int user_src, uint64 src, int n) {
+  acquire(&kmsg.lock);
+  kmsg.start = kmsg.w;
+  release(&kmsg.lock);
+  return n;
+}
+
+void kmsginit(void) {
+  initlock(&kmsg.lock, "kmsg");
+  devsw[KMSG].read = kmsgread;
+  devsw[KMSG].write = kmsgwrite;
+}
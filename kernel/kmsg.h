@@ -0,0 +1,15 @@
+#pragma once
+
+#include "types.h"
+
+// The kernel log: the last KMSG_SIZE bytes of printf() output, read
+// from the KMSG device. A read returns as much of the log as fits,
+// latest text last. Writing anything clears it.
+
+#define KMSG_SIZE 16384
+
+void kmsginit(void);
+void kmsg_write(char *s, int n);
+int kmsg_getc(void);
+int kmsg_pending(void);
+void kmsg_flush_sync(void);
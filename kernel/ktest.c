@@ -0,0 +1,144 @@
+// Kernel self-tests, see ktest.h.
+//
+// Each test returns 0 on success. A benchmark prints its own results.
+
+#include "ktest.h"
+
+#include "mem/kalloc.h"
+#include "printf.h"
+#include "riscv.h"
+#include "util/string.h"
+
+#ifdef KTEST
+
+// Room for the offsets and lengths the tests try, plus guard bytes.
+#define TBUF 512
+#define NBENCH 32
+
+static uchar *buf, *ref;
+
+static void fill(uchar *p, int n, int seed) {
+  for (int i = 0; i < n; i++) p[i] = i * 13 + seed;
+}
+
+// Byte-at-a-time reference versions.
+
+static void ref_memset(uchar *d, int c, uint n) {
+  while (n-- > 0) *d++ = c;
+}
+
+static void ref_memmove(uchar *d, const uchar *s, uint n) {
+  if (s < d && s + n > d)
+    while (n-- > 0) d[n] = s[n];
+  else
+    while (n-- > 0) *d++ = *s++;
+}
+
+static int test_memset(void) {
+  for (int off = 0; off < 16; off++) {
+    for (int n = 0; n < 160; n++) {
+      fill(buf, TBUF, n);
+      fill(ref, TBUF, n);
+      memset(buf + off, 0xa5, n);
+      ref_memset(ref + off, 0xa5, n);
+      if (memcmp(buf, ref, TBUF) != 0) {
+        printf("memset(+%d, %d) wrong\n", off, n);
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+// Copies between every alignment, in both directions and overlapping.
+static int test_memmove(void) {
+  for (int so = 0; so < 48; so++) {
+    for (int dof = 0; dof < 48; dof++) {
+      for (int n = 0; n < 160; n++) {
+        fill(buf, TBUF, so);
+        fill(ref, TBUF, so);
+        memmove(buf + dof, buf + so, n);
+        ref_memmove(ref + dof, ref + so, n);
+        if (memcmp(buf, ref, TBUF) != 0) {
+          printf("memmove(+%d, +%d, %d) wrong\n", dof, so, n);
+          return -1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+static int test_memcpy(void) {
+  for (int so = 0; so < 16; so++) {
+    for (int dof = 0; dof < 16; dof++) {
+      for (int n = 0; n < 160; n++) {
+        fill(buf, TBUF, n);
+        fill(ref, TBUF, n);
+        memcpy(buf + dof, buf + 256 + so, n);
+        ref_memmove(ref + dof, ref + 256 + so, n);
+        if (memcmp(buf, ref, TBUF) != 0) {
+          printf("memcpy(+%d, +%d, %d) wrong\n", dof, so, n);
+          return -1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+static struct {
+  char *name;
+  int (*fn)(void);
+} tests[] = {
+    {"memset", test_memset},
+    {"memmove", test_memmove},
+    {"memcpy", test_memcpy},
+};
+
+// Cycles per page-sized call, averaged over NBENCH calls.
+static void bench_mem(void) {
+  uchar *a = kalloc(), *b = kalloc();
+  uint64 t;
+
+  if (a == 0 || b == 0) panic("bench_mem");
+
+#define BENCH(what, call)                               \
+  t = r_cycle();                                        \
+  for (int i = 0; i < NBENCH; i++) call;                \
+  printf("ktest: %s: %d cycles/page\n", what,           \
+         (int)((r_cycle() - t) / NBENCH))
+
+  BENCH("memset", memset(a, 0, PGSIZE));
+  BENCH("byte memset", ref_memset(a, 0, PGSIZE));
+  BENCH("memcpy", memcpy(a, b, PGSIZE));
+  BENCH("memmove", memmove(a, b, PGSIZE));
+  BENCH("memmove misaligned", memmove(a + 1, b, PGSIZE - 1));
+  BENCH("byte memmove", ref_memmove(a, b, PGSIZE));
+#undef BENCH
+
+  kfree(a);
+  kfree(b);
+}
+
+void ktest(void) {
+  int failed = 0;
+
+  if ((buf = kalloc()) == 0 || (ref = kalloc()) == 0) panic("ktest");
+  for (int i = 0; i < NELEM(tests); i++) {
+    int r = tests[i].fn();
+    printf("ktest: %s %s\n", tests[i].name, r == 0 ? "ok" : "FAILED");
+    if (r != 0) failed++;
+  }
+  kfree(buf);
+  kfree(ref);
+  if (failed) panic("ktest");
+
+  bench_mem();
+}
+
+#else
+
+void ktest(void) {}
+
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+
+// Kernel self-tests and micro-benchmarks. In kernels built with
+// KTEST=1, ktest() runs them at boot and panics if any test fails;
+// otherwise it does nothing.
+void ktest(void);
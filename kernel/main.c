@@ -1,11 +1,15 @@
 #include "console.h"
 #include "dev/plic.h"
 #include "dev/virtio.h"
+#include "events.h"
+#include "kmsg.h"
+#include "ktest.h"
 #include "mem/kalloc.h"
 #include "mem/vm.h"
 #include "proc/proc.h"
 #include "proc/trap.h"
 #include "printf.h"
+#include "syscall.h"
 
 volatile static int started = 0;
 
@@ -20,15 +24,21 @@ void main() {
     kinit();             // physical page allocator
     kvminit();           // create kernel page table
     kvminithart();       // turn on paging
-    procinit();          // process table
     trapinit();          // trap vectors
+    procinit();          // process table
     trapinithart();      // install kernel trap vector
     plicinit();          // set up interrupt controller
     plicinithart();      // ask PLIC for device interrupts
     binit();             // buffer cache
     iinit();             // inode table
     fileinit();          // file table
+    sysstatinit();       // system call statistics devices
+    profinit();          // sampling profiler device
+    lockstatinit();      // spinlock statistics device
+    eventsinit();        // event counters device
+    kmsginit();          // kernel log device
     virtio_disk_init();  // emulated hard disk
+    ktest();             // self-tests, with KTEST=1
     userinit();          // first user process
     __sync_synchronize();
     started = 1;
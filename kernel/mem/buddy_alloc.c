@@ -6,6 +6,7 @@
 #include "../printf.h"
 #include "../util/bitset.h"
 #include "../util/free_mem_list.h"
+#include "../util/percpu.h"
 #include "../util/spinlock.h"
 #include "../util/string.h"
 
@@ -30,7 +31,11 @@ struct level_info {
 static struct level_info *lvl_sizes;
 static void *allocator_base;
 static struct spinlock lock;
-static uint64 free_mem;
+
+// Free bytes. havemem() sums it exactly; each hart's slot folds into the
+// total every 64 pages.
+static struct percpu_counter free_mem;
+#define FREE_MEM_BATCH (64 * 4096)
 
 int first_level_contains(uint64 n) {
   int lvl = 0;
@@ -66,7 +71,6 @@ void *malloc_buddy(uint64 n) {
     release(&lock);
     return 0;
   }
-  free_mem -= BLK_SIZE(fk);
   char *p = fm_list_pop(&lvl_sizes[k].free);
   bit_invert(lvl_sizes[k].allocated, ptr_block_index(k, p) >> 1);
   for (; k > fk; k--) {
@@ -77,6 +81,7 @@ void *malloc_buddy(uint64 n) {
     fm_list_push(&lvl_sizes[k - 1].free, buddy);  // buddy is available
   }
   release(&lock);
+  percpu_counter_add(&free_mem, -BLK_SIZE(fk));
   return p;
 }
 
@@ -93,8 +98,8 @@ int ptr_block_size(const char *p) {
 void free_buddy(void *p) {
   int k = ptr_block_size(p);
 
+  percpu_counter_add(&free_mem, BLK_SIZE(k));
   acquire(&lock);
-  free_mem += BLK_SIZE(k);
   for (; k < MAXSIZE; k++) {
     uint64 block_index = ptr_block_index(k, p);
     uint64 buddy = ((block_index & 1) == 0) ? block_index + 1 : block_index - 1;
@@ -116,7 +121,7 @@ void free_buddy(void *p) {
   release(&lock);
 }
 
-uint64 havemem_buddy() { return free_mem; }
+uint64 havemem_buddy() { return percpu_counter_sum(&free_mem); }
 
 // First block with size k that doesn't contain p
 uint64 next_block_index(int k, char *p) {
@@ -263,7 +268,7 @@ void init_buddy(void *base, void *end) {
 
   // initialize free lists for each size k
   uint64 free = bd_initfree(p, bd_end);
-  free_mem = free;
+  percpu_counter_init(&free_mem, free, FREE_MEM_BATCH);
 
   // check if the amount that is free is what we expect
   if (free != BLK_SIZE(MAXSIZE) - meta - unavailable) {
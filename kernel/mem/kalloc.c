@@ -5,6 +5,7 @@
 #include "kalloc.h"
 
 #include "buddy_alloc.h"
+#include "../events.h"
 #include "../mem/memlayout.h"
 #include "../riscv.h"
 
@@ -24,7 +25,11 @@ void kfree(void *pa) { free_buddy(pa); }
 // Allocate one 4096-byte page of physical memory.
 // Returns a pointer that the kernel can use.
 // Returns 0 if the memory cannot be allocated.
-void *kalloc(void) { return malloc_buddy(PGSIZE); }
+void *kalloc(void) {
+  void *p = malloc_buddy(PGSIZE);
+  if (p) count_event(EV_KALLOC);
+  return p;
+}
 
 void *malloc(uint64 n) { return malloc_buddy(n); }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../param.h"
 #include "../riscv.h"
 
 // Physical memory layout
@@ -31,8 +32,11 @@
 
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4 * (hartid))  // software interrupt.
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8 * (hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8)  // cycles since boot.
+#define CLINT_FREQ 10000000  // CLINT_MTIME ticks per second.
+#define TICK_INTERVAL (CLINT_FREQ / 10)  // CLINT_MTIME cycles per tick.
 
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
@@ -66,6 +70,15 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   USYSRING (struct uring, mapped by ring_setup())
+//   trapframes of the other threads, one page per thread
 //   TRAPFRAME (p->trapframe, used by the trampoline)
+//   USYSTHREADS (struct uthread per thread, read-only)
+//   USYSDATA (struct usysdata, read-only, shared by all processes)
 //   TRAMPOLINE (the same page as in the kernel)
-#define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define USYSDATA (TRAMPOLINE - PGSIZE)
+#define USYSTHREADS (USYSDATA - PGSIZE)
+#define USYSTHREAD(i) (USYSTHREADS + (i) * sizeof(struct uthread))
+#define TRAPFRAME (USYSTHREADS - PGSIZE)
+#define TRAPFRAME_SLOT(i) (TRAPFRAME - (i) * PGSIZE)
+#define USYSRING (TRAPFRAME_SLOT(NTHREAD - 1) - PGSIZE)
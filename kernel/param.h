@@ -3,6 +3,7 @@
 #define NPROC 64                   // maximum number of processes
 #define NCPU 8                     // maximum number of CPUs
 #define NOFILE 16                  // open files per process
+#define NTHREAD 16                 // maximum threads per process
 #define NFILE 100                  // open files per system
 #define NINODE 50                  // maximum number of active i-nodes
 #define NDEV 10                    // maximum major device number
@@ -1,5 +1,8 @@
 //
 // formatted console output -- printf, panic.
+// printf() goes to the kernel log, which the UART
+// is fed from in the background; panic() writes to
+// the UART directly.
 //
 
 #include "printf.h"
@@ -7,17 +10,37 @@
 #include <stdarg.h>
 
 #include "console.h"
+#include "dev/uart.h"
+#include "kmsg.h"
 #include "util/spinlock.h"
 #include "types.h"
 
 volatile int panicked = 0;
 
 // lock to avoid interleaving concurrent printf's.
+// without locking, which is only during a panic,
+// printf() writes to the UART synchronously.
 static struct {
   struct spinlock lock;
   int locking;
+  char buf[64];  // output not yet in the log
+  int n;
 } pr;
 
+static void flush(void) {
+  kmsg_write(pr.buf, pr.n);
+  pr.n = 0;
+}
+
+static void outc(int c) {
+  if (!pr.locking) {
+    consputc(c);
+    return;
+  }
+  pr.buf[pr.n++] = c;
+  if (pr.n == sizeof(pr.buf)) flush();
+}
+
 static char digits[] = "0123456789abcdef";
 
 static void printint(int xx, int base, int sign) {
@@ -37,15 +60,15 @@ static void printint(int xx, int base, int sign) {
 
   if (sign) buf[i++] = '-';
 
-  while (--i >= 0) consputc(buf[i]);
+  while (--i >= 0) outc(buf[i]);
 }
 
 static void printptr(uint64 x) {
   int i;
-  consputc('0');
-  consputc('x');
+  outc('0');
+  outc('x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    consputc(digits[x >> (sizeof(uint64) * 8 - 4)]);
+    outc(digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
 // Print to the console. only understands %d, %x, %p, %s.
@@ -62,7 +85,7 @@ void printf(char *fmt, ...) {
   va_start(ap, fmt);
   for (i = 0; (c = fmt[i] & 0xff) != 0; i++) {
     if (c != '%') {
-      consputc(c);
+      outc(c);
       continue;
     }
     c = fmt[++i] & 0xff;
@@ -79,25 +102,30 @@ void printf(char *fmt, ...) {
         break;
       case 's':
         if ((s = va_arg(ap, char *)) == 0) s = "(null)";
-        for (; *s; s++) consputc(*s);
+        for (; *s; s++) outc(*s);
         break;
       case '%':
-        consputc('%');
+        outc('%');
         break;
       default:
         // Print unknown % sequence to draw attention.
-        consputc('%');
-        consputc(c);
+        outc('%');
+        outc(c);
         break;
     }
   }
   va_end(ap);
 
-  if (locking) release(&pr.lock);
+  if (locking) {
+    flush();
+    release(&pr.lock);
+    uartkick();
+  }
 }
 
 void panic(char *s) {
   pr.locking = 0;
+  kmsg_flush_sync();
   printf("panic: ");
   printf(s);
   printf("\n");
@@ -6,6 +6,7 @@
 #include "../param.h"
 #include "../printf.h"
 #include "../proc/proc.h"
+#include "../ring.h"
 #include "../util/string.h"
 
 static int loadseg(pde_t *, uint64, struct inode *, uint, uint);
@@ -18,6 +19,17 @@ int flags2perm(int flags) {
 }
 
 int exec(char *path, char **argv) {
+  struct proc *p = myproc();
+
+  // The other threads would be left running on a freed image.
+  if (p->tg->nlive > 1) return -1;
+  return exec_image(p, path, argv);
+}
+
+// Replace p's user image with the program at path.
+// p is the caller, or a new process nobody else uses yet.
+// Returns argc, or -1 with p's old image untouched.
+int exec_image(struct proc *p, char *path, char **argv) {
   char *s, *last;
   int i, off;
   uint64 argc, sz = 0, sp, ustack[MAXARG], stackbase;
@@ -25,7 +37,6 @@ int exec(char *path, char **argv) {
   struct inode *ip;
   struct proghdr ph;
   pagetable_t pagetable = 0, oldpagetable;
-  struct proc *p = myproc();
 
   begin_op();
 
@@ -33,7 +44,7 @@ int exec(char *path, char **argv) {
     end_op();
     return -1;
   }
-  ilock(ip);
+  ilock_shared(ip);
 
   // Check ELF header
   if (readi(ip, 0, (uint64)&elf, 0, sizeof(elf)) != sizeof(elf)) goto bad;
@@ -60,8 +71,7 @@ int exec(char *path, char **argv) {
   end_op();
   ip = 0;
 
-  p = myproc();
-  uint64 oldsz = p->sz;
+  uint64 oldsz = p->tg->sz;
 
   // Allocate two pages at the next page boundary.
   // Make the first inaccessible as a stack guard.
@@ -104,17 +114,18 @@ int exec(char *path, char **argv) {
   safestrcpy(p->name, last, sizeof(p->name));
 
   // Commit to the user image.
-  oldpagetable = p->pagetable;
-  p->pagetable = pagetable;
-  p->sz = sz;
+  ring_free(p->tg);
+  oldpagetable = p->tg->pagetable;
+  p->tg->pagetable = pagetable;
+  p->tg->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp;          // initial stack pointer
-  proc_freepagetable(oldpagetable, oldsz);
+  proc_freepagetable(oldpagetable, oldsz, p->tslot);
 
   return argc;  // this ends up in a0, the first argument to main(argc, argv)
 
 bad:
-  if (pagetable) proc_freepagetable(pagetable, sz);
+  if (pagetable) proc_freepagetable(pagetable, sz, p->tslot);
   if (ip) {
     iunlockput(ip);
     end_op();
@@ -1,3 +1,6 @@
 #pragma once
 
+struct proc;
+
 int exec(char*, char**);
+int exec_image(struct proc*, char*, char**);
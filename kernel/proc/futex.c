@@ -0,0 +1,109 @@
+// Futexes: sleep until another thread wakes the same user word.
+//
+// A futex is keyed by the physical address of the word, so threads
+// sharing the page table agree on it. Waiters are kept in a hash table
+// of wait queues, each guarded by its own lock. A waiter's entry lives
+// on its kernel stack for as long as it sleeps.
+
+#include "futex.h"
+
+#include "../mem/vm.h"
+#include "proc.h"
+
+#define NBUCKET 64
+
+struct futex_waiter {
+  uint64 pa;  // physical address of the word
+  int woken;
+  struct futex_waiter *next;
+};
+
+struct {
+  struct spinlock lock;
+  struct futex_waiter *head;
+} __attribute__((aligned(64))) buckets[NBUCKET];
+
+void futexinit(void) {
+  for (int i = 0; i < NBUCKET; i++) initlock(&buckets[i].lock, "futex");
+}
+
+// Physical address of the aligned user word at uaddr, or 0.
+static uint64 futex_pa(uint64 uaddr) {
+  if (uaddr % sizeof(int) != 0) return 0;
+  uint64 pa = walkaddr(myproc()->tg->pagetable, PGROUNDDOWN(uaddr));
+  if (pa == 0) return 0;
+  return pa + (uaddr - PGROUNDDOWN(uaddr));
+}
+
+static int bucket_of(uint64 pa) { return ((pa >> 2) ^ (pa >> 12)) % NBUCKET; }
+
+static void unlink(struct futex_waiter **pp, struct futex_waiter *w) {
+  for (; *pp; pp = &(*pp)->next) {
+    if (*pp == w) {
+      *pp = w->next;
+      return;
+    }
+  }
+}
+
+// Sleep until futex_wake() on uaddr, if the word there still equals val.
+// The check and going to sleep are atomic with respect to futex_wake().
+// Returns 0 when woken, -1 if the word changed, uaddr is bad, or the
+// process was killed.
+int futex_wait(uint64 uaddr, int val) {
+  struct futex_waiter w, **pp;
+  uint64 pa;
+
+  if ((pa = futex_pa(uaddr)) == 0) return -1;
+  int b = bucket_of(pa);
+
+  acquire(&buckets[b].lock);
+  if (*(volatile int *)pa != val) {
+    release(&buckets[b].lock);
+    return -1;
+  }
+  // Queue at the tail, so waiters are woken in FIFO order.
+  w.pa = pa;
+  w.woken = 0;
+  w.next = 0;
+  for (pp = &buckets[b].head; *pp; pp = &(*pp)->next)
+    ;
+  *pp = &w;
+
+  while (!w.woken) {
+    if (killed(myproc())) {
+      unlink(&buckets[b].head, &w);
+      release(&buckets[b].lock);
+      return -1;
+    }
+    sleep(&w, &buckets[b].lock);
+  }
+  release(&buckets[b].lock);
+  return 0;
+}
+
+// Wake up to n threads waiting on uaddr.
+// Returns the number woken, or -1 if uaddr is bad.
+int futex_wake(uint64 uaddr, int n) {
+  struct futex_waiter **pp, *w;
+  uint64 pa;
+  int woken = 0;
+
+  if ((pa = futex_pa(uaddr)) == 0) return -1;
+  int b = bucket_of(pa);
+
+  acquire(&buckets[b].lock);
+  for (pp = &buckets[b].head; *pp && woken < n;) {
+    w = *pp;
+    if (w->pa != pa) {
+      pp = &w->next;
+      continue;
+    }
+    *pp = w->next;
+    w->woken = 1;
+    wakeup(w);
+    woken++;
+  }
+  release(&buckets[b].lock);
+  return woken;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "../types.h"
+
+void futexinit(void);
+int futex_wait(uint64 uaddr, int val);
+int futex_wake(uint64 uaddr, int n);
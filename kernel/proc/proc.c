@@ -1,22 +1,32 @@
 #include "proc.h"
 
-#include "free_proc_pool.h"
+#include "../dev/clint.h"
+#include "../events.h"
 #include "../fs/fs.h"
 #include "../fs/log.h"
 #include "../mem/kalloc.h"
 #include "../mem/memlayout.h"
 #include "../mem/vm.h"
 #include "../printf.h"
+#include "../ring.h"
+#include "../syscall.h"
+#include "../syscall_numbers.h"
+#include "../util/epoch.h"
 #include "../util/string.h"
 #include "../util/vector.h"
+#include "exec.h"
+#include "futex.h"
 #include "kstack_provider.h"
+#include "spawn.h"
+#include "timer.h"
 #include "trap.h"
+#include "vdso.h"
 
 struct cpu cpus[NCPU];
 
-// We don't need to sync when accessing size, it only grows
-// This is a vector, we lock it only when adding a process or accessing an
-// element
+// proc_lock serializes adding and removing processes, readers go through
+// claim_proc() without it. The list shrinks when its tail empties, so a
+// reader's proc_list_size() may be stale; claim_proc() then returns 0.
 struct {
   struct vector proc;
   struct spinlock proc_lock;
@@ -24,11 +34,17 @@ struct {
 
 struct proc *initproc;
 
+// Harts that have entered the scheduler
+static uint64 cpus_online;
+
 int nextpid = 1;
-struct spinlock pid_lock;
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static int tg_join(struct proc *p, struct tgroup *tg);
+static void tg_put(struct proc *p);
+static int waitpid(int pid, uint64 addr);
+static void free_proc_struct(struct epoch_node *n);
 
 extern char trampoline[];  // trampoline.S
 
@@ -60,35 +76,22 @@ void remove_proc_from_list(struct proc *p) {
   if (p->list_index == -1) return;
   acquire(&proc_list.proc_lock);
   v_set(&proc_list.proc, p->list_index, 0);
+  v_compact(&proc_list.proc);
   release(&proc_list.proc_lock);
 }
 
-// Get i-th element from a proc list, and if it exists increase p->watching
-// while holding a lock, so we'll avoid NPE
+// Get i-th element from a proc list, without locking.
+// Must be called between epoch_enter() and epoch_exit(): the struct stays
+// allocated until epoch_exit(), even if the process is freed meanwhile.
 // Elements of the proc list must be accessed by this method only
 struct proc *claim_proc(int i) {
-  acquire(&proc_list.proc_lock);
-  struct proc *p = (struct proc *)v_get(&proc_list.proc, i);
-
-  if (p == 0) {
-    release(&proc_list.proc_lock);
-    return 0;
-  }
-  // Here sync is needed because stop_watching_proc accesses this field without
-  // any lock
-  __sync_fetch_and_add(&p->watching, 1);
-  release(&proc_list.proc_lock);
-
-  return p;
+  return (struct proc *)v_get(&proc_list.proc, i);
 }
 
-// When we are no longer using p, we can stop watching it
-void stop_watching_proc(struct proc *p) {
-  __sync_fetch_and_sub(&p->watching, 1);
+int proc_list_size() {
+  return __atomic_load_n(&proc_list.proc.size, __ATOMIC_ACQUIRE);
 }
 
-int proc_list_size() { return proc_list.proc.size; }
-
 // Allocate a page for each process's kernel stack.
 // Map it high in memory, followed by an invalid
 // guard page.
@@ -96,11 +99,12 @@ void proc_mapstacks(pagetable_t kpgtbl) { k_pagetable = kpgtbl; }
 
 // initialize the proc table.
 void procinit(void) {
-  initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
   proc_list_init();
-  init_pool();
   init_kstack_provider();
+  futexinit();
+  vdsoinit();
+  timersinit();
 }
 
 // Must be called with interrupts disabled,
@@ -128,22 +132,16 @@ struct proc *myproc(void) {
   return p;
 }
 
-int allocpid() {
-  int pid;
-
-  acquire(&pid_lock);
-  pid = nextpid;
-  nextpid = nextpid + 1;
-  release(&pid_lock);
-
-  return pid;
-}
+// pids have to be unique, so they can't come from per-hart counters;
+// a single atomic add does without the lock, though.
+int allocpid() { return __atomic_fetch_add(&nextpid, 1, __ATOMIC_RELAXED); }
 
 // Look in the process table for an UNUSED proc.
 // If found, initialize state required to run in the kernel,
+// make it a thread of tg, or of a new thread group when tg is 0,
 // and return with p->lock held.
 // If there are no free procs, or a memory allocation fails, return 0.
-static struct proc *allocproc(void) {
+static struct proc *allocproc(struct tgroup *tg) {
   struct proc *p = malloc(sizeof(struct proc));
   if (p == 0) return 0;
   memset(p, 0, sizeof(struct proc));
@@ -152,6 +150,7 @@ static struct proc *allocproc(void) {
   acquire(&p->lock);
   p->pid = allocpid();
   p->state = USED;
+  p->affinity = ~0UL;
   p->list_index = -1;
 
   void *kstack_page = kalloc();
@@ -174,9 +173,8 @@ static struct proc *allocproc(void) {
     return 0;
   }
 
-  // An empty user page table.
-  p->pagetable = proc_pagetable(p);
-  if (p->pagetable == 0) {
+  // Share tg's memory, or start with an empty user page table.
+  if (tg_join(p, tg) < 0) {
     freeproc(p);
     return 0;
   }
@@ -190,10 +188,11 @@ static struct proc *allocproc(void) {
   // Put process in a process list
   p->list_index = push_proc(p);
   if (p->list_index < 0) {
-    p->list_index = 0;
+    p->list_index = -1;
     freeproc(p);
     return 0;
   }
+  count_event(EV_FORK);
   return p;
 }
 
@@ -201,8 +200,8 @@ static struct proc *allocproc(void) {
 // including user pages.
 // p->lock must be held.
 static void freeproc(struct proc *p) {
+  if (p->tg) tg_put(p);
   if (p->trapframe) kfree((void *)p->trapframe);
-  if (p->pagetable) proc_freepagetable(p->pagetable, p->sz);
   if (p->kstack) {
     uvmunmap(k_pagetable, p->kstack, 1, 1);
     return_kstack_va(p->kstack);
@@ -210,13 +209,54 @@ static void freeproc(struct proc *p) {
   remove_proc_from_list(p);
   release(&p->lock);
 
-  // Our struct is now unused, so we want to free it when nobody is accessing it
-  // anymore
-  push_pool(p);
+  // Other harts may still be looking at p through the proc list,
+  // so free it once they're done.
+  epoch_retire(&p->epoch_node, free_proc_struct);
+}
+
+// Charge the time since p's last state change to *acc.
+// p->lock must be held.
+static void account(struct proc *p, uint64 *acc, uint64 now) {
+  *acc += now - p->state_time;
+  p->state_time = now;
+}
+
+static uint64 ticks_to_us(uint64 t) { return t / (CLINT_FREQ / 1000000); }
+
+// Run queue latency histogram bucket for a wait of t ticks.
+static int lat_bucket(uint64 t) {
+  uint64 us = ticks_to_us(t);
+  int b = 0;
+  while (us > 0 && b < RUSAGE_LAT_BUCKETS - 1) {
+    us >>= 1;
+    b++;
+  }
+  return b;
+}
+
+// Copy p's usage to *ru, including the current state's unfinished
+// interval, with times in microseconds. p->lock must be held.
+static void proc_rusage(struct proc *p, struct rusage *ru) {
+  uint64 now = r_time();
+
+  *ru = p->ru;
+  if (p->state == RUNNING)
+    ru->cpu_time += now - p->state_time;
+  else if (p->state == RUNNABLE)
+    ru->wait_time += now - p->state_time;
+  else if (p->state == SLEEPING)
+    ru->sleep_time += now - p->state_time;
+  ru->cpu_time = ticks_to_us(ru->cpu_time);
+  ru->wait_time = ticks_to_us(ru->wait_time);
+  ru->sleep_time = ticks_to_us(ru->sleep_time);
+}
+
+static void free_proc_struct(struct epoch_node *n) {
+  kfree(epoch_container(n, struct proc, epoch_node));
 }
 
 // Create a user page table for a given process, with no user memory,
-// but with trampoline and trapframe pages.
+// but with trampoline, p's trapframe and the usysdata pages.
 pagetable_t proc_pagetable(struct proc *p) {
   pagetable_t pagetable;
 
@@ -234,11 +274,19 @@ pagetable_t proc_pagetable(struct proc *p) {
     return 0;
   }
 
-  // map the trapframe page just below the trampoline page, for
+  // map the trapframe page below the trampoline page, for
   // trampoline.S.
-  if (mappages(pagetable, TRAPFRAME, PGSIZE, (uint64)(p->trapframe),
-               PTE_R | PTE_W) < 0) {
+  if (mappages(pagetable, TRAPFRAME_SLOT(p->tslot), PGSIZE,
+               (uint64)(p->trapframe), PTE_R | PTE_W) < 0) {
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
+  // map the read-only kernel data pages, see usysdata.h.
+  if (vdso_map(pagetable, p->tg->uthreads) < 0) {
     uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmunmap(pagetable, TRAPFRAME_SLOT(p->tslot), 1, 0);
     uvmfree(pagetable, 0);
     return 0;
   }
@@ -247,13 +295,97 @@ pagetable_t proc_pagetable(struct proc *p) {
 }
 
 // Free a process's page table, and free the
-// physical memory it refers to.
-void proc_freepagetable(pagetable_t pagetable, uint64 sz) {
+// physical memory it refers to. slot is the one trapframe still
+// mapped, or -1 if there is none.
+void proc_freepagetable(pagetable_t pagetable, uint64 sz, int slot) {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
-  uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  vdso_unmap(pagetable);
+  if (slot >= 0) uvmunmap(pagetable, TRAPFRAME_SLOT(slot), 1, 0);
   uvmfree(pagetable, sz);
 }
 
+// Make p a thread of tg, mapping its trapframe into a free slot of
+// tg's page table. If tg is 0, put p alone in a new group with an
+// empty user page table. Returns 0 on success, -1 on failure.
+static int tg_join(struct proc *p, struct tgroup *tg) {
+  int slot;
+
+  if (tg == 0) {
+    if ((tg = malloc(sizeof(struct tgroup))) == 0) return -1;
+    memset(tg, 0, sizeof(struct tgroup));
+    initlock(&tg->lock, "tgroup");
+    initsleeplock(&tg->ringlock, "ring");
+    if ((tg->uthreads = kalloc()) == 0) {
+      kfree(tg);
+      return -1;
+    }
+    memset(tg->uthreads, 0, PGSIZE);
+    p->tslot = 0;
+    p->tg = tg;
+    if ((tg->pagetable = proc_pagetable(p)) == 0) {
+      p->tg = 0;
+      kfree(tg->uthreads);
+      kfree(tg);
+      return -1;
+    }
+    tg->uthreads[0].pid = p->pid;
+    tg->slots = 1;
+    tg->ref = 1;
+    tg->nlive = 1;
+    return 0;
+  }
+
+  acquire(&tg->lock);
+  for (slot = 0; slot < NTHREAD; slot++)
+    if ((tg->slots & (1UL << slot)) == 0) break;
+  if (slot == NTHREAD ||
+      mappages(tg->pagetable, TRAPFRAME_SLOT(slot), PGSIZE,
+               (uint64)(p->trapframe), PTE_R | PTE_W) < 0) {
+    release(&tg->lock);
+    return -1;
+  }
+  tg->slots |= 1UL << slot;
+  tg->uthreads[slot].pid = p->pid;
+  tg->ref++;
+  tg->nlive++;
+  release(&tg->lock);
+
+  p->tslot = slot;
+  p->tg = tg;
+  return 0;
+}
+
+// p won't return to user space anymore: unmap its trapframe, so the
+// slot can be reused, and count it out of the live threads.
+// Returns 1 if p was the last live thread. tg->lock must be held.
+static int tg_leave(struct proc *p) {
+  struct tgroup *tg = p->tg;
+
+  uvmunmap(tg->pagetable, TRAPFRAME_SLOT(p->tslot), 1, 0);
+  tg->slots &= ~(1UL << p->tslot);
+  p->tslot = -1;
+  return --tg->nlive == 0;
+}
+
+// Drop p's reference to its thread group. The last one frees the
+// group's user memory; its files were closed by the last exit().
+static void tg_put(struct proc *p) {
+  struct tgroup *tg = p->tg;
+
+  acquire(&tg->lock);
+  if (p->tslot >= 0) tg_leave(p);
+  int last = (--tg->ref == 0);
+  release(&tg->lock);
+
+  p->tg = 0;
+  if (last) {
+    ring_free(tg);
+    proc_freepagetable(tg->pagetable, tg->sz, -1);
+    kfree(tg->uthreads);
+    kfree(tg);
+  }
+}
+
 // a user program that calls exec("/init")
 // assembled from ../user/initcode.S
 // od -t xC ../user/initcode
@@ -268,41 +400,51 @@ uchar initcode[] = {0x17, 0x05, 0x00, 0x00, 0x13, 0x05, 0x45, 0x02, 0x97,
 void userinit(void) {
   struct proc *p;
 
-  p = allocproc();
+  p = allocproc(0);
   initproc = p;
 
   // allocate one user page and copy initcode's instructions
   // and data into it.
-  uvmfirst(p->pagetable, initcode, sizeof(initcode));
-  p->sz = PGSIZE;
+  uvmfirst(p->tg->pagetable, initcode, sizeof(initcode));
+  p->tg->sz = PGSIZE;
 
   // prepare for the very first "return" from kernel to user.
   p->trapframe->epc = 0;      // user program counter
   p->trapframe->sp = PGSIZE;  // user stack pointer
 
   safestrcpy(p->name, "initcode", sizeof(p->name));
-  p->cwd = namei("/");
+  p->tg->cwd = namei("/");
 
   p->state = RUNNABLE;
+  p->state_time = r_time();
 
   release(&p->lock);
 }
 
-// Grow or shrink user memory by n bytes.
-// Return 0 on success, -1 on failure.
-int growproc(int n) {
+// Grow or shrink user memory by n bytes, setting *oldsz to the
+// size beforehand. Return 0 on success, -1 on failure.
+int growproc(int n, uint64 *oldsz) {
   uint64 sz;
-  struct proc *p = myproc();
+  struct tgroup *tg = myproc()->tg;
 
-  sz = p->sz;
+  acquire(&tg->lock);
+  sz = *oldsz = tg->sz;
   if (n > 0) {
-    if ((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
+    if ((sz = uvmalloc(tg->pagetable, sz, sz + n, PTE_W)) == 0) {
+      release(&tg->lock);
       return -1;
     }
   } else if (n < 0) {
-    sz = uvmdealloc(p->pagetable, sz, sz + n);
+    // Other threads may be using the pages, or still have them
+    // in their harts' TLBs.
+    if (tg->nlive > 1) {
+      release(&tg->lock);
+      return -1;
+    }
+    sz = uvmdealloc(tg->pagetable, sz, sz + n);
   }
-  p->sz = sz;
+  tg->sz = sz;
+  release(&tg->lock);
   return 0;
 }
 
@@ -314,16 +456,20 @@ int fork(void) {
   struct proc *p = myproc();
 
   // Allocate process.
-  if ((np = allocproc()) == 0) {
+  if ((np = allocproc(0)) == 0) {
     return -1;
   }
 
   // Copy user memory from parent to child.
-  if (uvmcopy(p->pagetable, np->pagetable, p->sz) < 0) {
+  // Other threads of the parent may be growing it.
+  acquire(&p->tg->lock);
+  if (uvmcopy(p->tg->pagetable, np->tg->pagetable, p->tg->sz) < 0) {
+    release(&p->tg->lock);
     freeproc(np);
     return -1;
   }
-  np->sz = p->sz;
+  np->tg->sz = p->tg->sz;
+  release(&p->tg->lock);
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -332,12 +478,18 @@ int fork(void) {
   np->trapframe->a0 = 0;
 
   // increment reference counts on open file descriptors.
+  // Another thread may be closing them.
+  acquire(&p->tg->lock);
   for (i = 0; i < NOFILE; i++)
-    if (p->ofile[i]) np->ofile[i] = filedup(p->ofile[i]);
-  np->cwd = idup(p->cwd);
+    if (p->tg->ofile[i]) np->tg->ofile[i] = filedup(p->tg->ofile[i]);
+  release(&p->tg->lock);
+  np->tg->cwd = idup(p->tg->cwd);
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
+  np->affinity = p->affinity;
+  np->trace = p->trace;
+
   pid = np->pid;
 
   release(&np->lock);
@@ -348,8 +500,120 @@ int fork(void) {
 
   acquire(&np->lock);
   np->state = RUNNABLE;
+  np->state_time = r_time();
   release(&np->lock);
 
+  wake_idle_cpu(np->affinity);
+
+  return pid;
+}
+
+// Create a process running path with argv, without copying the caller's
+// memory. The child gets the caller's open files with acts applied in
+// order; files[i] is the file opened for a SPAWN_OPEN action, the child
+// takes its own reference. Duplicating a closed fd closes newfd.
+// Returns the child's pid, or -1.
+int spawn(char *path, char **argv, struct spawn_action *acts,
+          struct file **files, int nact) {
+  int i, pid, argc;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  // Allocate process.
+  if ((np = allocproc(0)) == 0) {
+    return -1;
+  }
+  // exec_image() may sleep, so it can't run under np->lock.
+  // Nobody else touches np while it is USED.
+  release(&np->lock);
+
+  memset(np->trapframe, 0, sizeof(*np->trapframe));
+  if ((argc = exec_image(np, path, argv)) < 0) {
+    acquire(&np->lock);
+    freeproc(np);
+    return -1;
+  }
+  np->trapframe->a0 = argc;
+
+  struct file **ofile = np->tg->ofile;
+  acquire(&p->tg->lock);
+  for (i = 0; i < NOFILE; i++)
+    if (p->tg->ofile[i]) ofile[i] = filedup(p->tg->ofile[i]);
+  release(&p->tg->lock);
+  np->tg->cwd = idup(p->tg->cwd);
+
+  for (i = 0; i < nact; i++) {
+    struct file *f = 0;
+    int fd = acts[i].fd;
+    if (acts[i].type == SPAWN_DUP2) {
+      f = ofile[fd];
+      fd = acts[i].newfd;
+    } else if (acts[i].type == SPAWN_OPEN) {
+      f = files[i];
+    }
+    if (f) filedup(f);
+    if (ofile[fd]) fileclose(ofile[fd]);
+    ofile[fd] = f;
+  }
+
+  np->affinity = p->affinity;
+  np->trace = p->trace;
+
+  pid = np->pid;
+
+  acquire(&wait_lock);
+  np->parent = p;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  np->state = RUNNABLE;
+  np->state_time = r_time();
+  release(&np->lock);
+
+  wake_idle_cpu(np->affinity);
+
+  return pid;
+}
+
+// Create a thread sharing the caller's memory, open files and current
+// directory. It starts with the caller's registers, except that it
+// runs fn(arg) on the user stack whose top is stack.
+// Returns the new thread's pid, or -1.
+int clone(uint64 fn, uint64 arg, uint64 stack) {
+  int pid;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  // Allocate a thread in the caller's group.
+  if ((np = allocproc(p->tg)) == 0) {
+    return -1;
+  }
+
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack & ~0xfUL;  // riscv sp must be 16-byte aligned
+
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  np->affinity = p->affinity;
+  np->trace = p->trace;
+
+  pid = np->pid;
+
+  release(&np->lock);
+
+  acquire(&wait_lock);
+  np->parent = p;
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  np->state = RUNNABLE;
+  np->state_time = r_time();
+  release(&np->lock);
+
+  wake_idle_cpu(np->affinity);
+
   return pid;
 }
 
@@ -358,6 +622,7 @@ int fork(void) {
 void reparent(struct proc *p) {
   struct proc *pp;
 
+  epoch_enter();
   int proc_number = proc_list_size();
 
   for (int i = 0; i < proc_number; i++) {
@@ -367,31 +632,44 @@ void reparent(struct proc *p) {
       pp->parent = initproc;
       wakeup(initproc);
     }
-    stop_watching_proc(pp);
   }
+  epoch_exit();
 }
 
-// Exit the current process.  Does not return.
-// An exited process remains in the zombie state
-// until its parent calls wait().
+// Exit the current thread.  Does not return.
+// An exited thread remains in the zombie state
+// until its parent calls wait() or join().
+// Open files are closed when the last thread of a process exits.
 void exit(int status) {
   struct proc *p = myproc();
+  struct tgroup *tg = p->tg;
 
   if (p == initproc) panic("init exiting");
 
-  // Close all open files.
-  for (int fd = 0; fd < NOFILE; fd++) {
-    if (p->ofile[fd]) {
-      struct file *f = p->ofile[fd];
-      fileclose(f);
-      p->ofile[fd] = 0;
-    }
+  if (p->trace) {
+    uint64 args[3] = {status, 0, 0};
+    trace_record(p, SYS_exit, args, 0, 0);
   }
 
-  begin_op();
-  iput(p->cwd);
-  end_op();
-  p->cwd = 0;
+  acquire(&tg->lock);
+  int last = tg_leave(p);
+  release(&tg->lock);
+
+  if (last) {
+    // Close all open files.
+    for (int fd = 0; fd < NOFILE; fd++) {
+      if (tg->ofile[fd]) {
+        struct file *f = tg->ofile[fd];
+        fileclose(f);
+        tg->ofile[fd] = 0;
+      }
+    }
+
+    begin_op();
+    iput(tg->cwd);
+    end_op();
+    tg->cwd = 0;
+  }
 
   acquire(&wait_lock);
 
@@ -415,9 +693,17 @@ void exit(int status) {
 
 // Wait for a child process to exit and return its pid.
 // Return -1 if this process has no children.
-int wait(uint64 addr) {
+int wait(uint64 addr) { return waitpid(-1, addr); }
+
+// Wait for the child thread or process with the given pid to exit.
+// Return -1 if there's no such child.
+int join(int pid, uint64 addr) { return waitpid(pid, addr); }
+
+// Wait for the child with the given pid, or any child if pid is -1,
+// to exit and return its pid. Return -1 if there's no such child.
+static int waitpid(int pid, uint64 addr) {
   struct proc *pp;
-  int havekids, pid;
+  int havekids;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
@@ -426,35 +712,37 @@ int wait(uint64 addr) {
     // Scan through table looking for exited children.
     havekids = 0;
 
+    epoch_enter();
     int proc_number = proc_list_size();
 
     for (int i = 0; i < proc_number; i++) {
       if ((pp = claim_proc(i)) == 0) continue;
 
-      if (pp->parent == p) {
+      if (pp->parent == p && (pid == -1 || pp->pid == pid)) {
         // make sure the child isn't still in exit() or swtch().
         acquire(&pp->lock);
 
         havekids = 1;
         if (pp->state == ZOMBIE) {
           // Found one.
-          pid = pp->pid;
-          if (addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
+          int cpid = pp->pid;
+          if (addr != 0 && copyout(p->tg->pagetable, addr,
+                                   (char *)&pp->xstate,
                                    sizeof(pp->xstate)) < 0) {
             release(&pp->lock);
+            epoch_exit();
             release(&wait_lock);
-            stop_watching_proc(pp);
             return -1;
           }
           freeproc(pp);
+          epoch_exit();
           release(&wait_lock);
-          stop_watching_proc(pp);
-          return pid;
+          return cpid;
         }
         release(&pp->lock);
       }
-      stop_watching_proc(pp);
     }
+    epoch_exit();
 
     // No point waiting if we don't have any children.
     if (!havekids || killed(p)) {
@@ -467,6 +755,123 @@ int wait(uint64 addr) {
   }
 }
 
+// Is there a RUNNABLE process allowed on hart? Reads p->state without
+// p->lock, so the answer is only a hint for idle().
+static int any_runnable(uint64 hart) {
+  struct proc *p;
+  int found = 0;
+
+  epoch_enter();
+  int proc_number = proc_list_size();
+
+  for (int i = 0; i < proc_number && !found; i++) {
+    if ((p = claim_proc(i)) == 0) continue;
+    found = (*(volatile enum procstate *)&p->state == RUNNABLE &&
+             (p->affinity & hart));
+  }
+  epoch_exit();
+  return found;
+}
+
+// Nothing to run: stall the hart in wfi until an interrupt arrives,
+// instead of rescanning the process list. Interrupts stay off between
+// the last check and wfi, so an IPI from wake_idle_cpu() sent after the
+// check remains pending and wfi returns at once.
+static void idle(struct cpu *c) {
+  intr_off();
+  c->idle = 1;
+  __sync_synchronize();
+  if (!any_runnable(1UL << cpuid())) {
+    uint64 t0 = r_time();
+    wfi();
+    c->idle_time += r_time() - t0;
+  }
+  c->idle = 0;
+  intr_on();
+}
+
+// A process allowed on the harts in mask became RUNNABLE: kick one of
+// them out of wfi, or failing that, get one running with its clock
+// ticks off to turn them back on. Pairs with idle() and update_ticks():
+// either the hart sees the process, or we see the hart's flag.
+void wake_idle_cpu(uint64 mask) {
+  __sync_synchronize();
+  for (int i = 0; i < NCPU; i++) {
+    if ((mask & (1UL << i)) && cpus[i].idle &&
+        __sync_bool_compare_and_swap(&cpus[i].idle, 1, 0)) {
+      clint_send_ipi(i);
+      return;
+    }
+  }
+  for (int i = 0; i < NCPU; i++) {
+    if ((mask & (1UL << i)) && cpus[i].tickless &&
+        __sync_bool_compare_and_swap(&cpus[i].tickless, 1, 0)) {
+      clint_send_ipi(i);
+      return;
+    }
+  }
+}
+
+// About to run a process on c: clock ticks could only preempt it in
+// favour of another process, so turn them off if there's none the hart
+// could run. Interrupts must be disabled.
+static void update_ticks(struct cpu *c, uint64 hart) {
+  c->tickless = 1;
+  __sync_synchronize();
+  // The profiler samples on clock ticks, so keep them while it's on.
+  int busy = any_runnable(hart) || prof_active();
+  if (busy) c->tickless = 0;
+
+  if (busy && !c->ticking)
+    clint_set_tick(r_time() + clint_interval());
+  else if (!busy && c->ticking)
+    clint_set_tick(-1);
+  c->ticking = busy;
+}
+
+// Called on an IPI. If wake_idle_cpu() cleared this hart's tickless
+// flag, turn clock ticks back on and return 1, so the caller yields.
+// Interrupts must be disabled.
+int resume_ticks(void) {
+  struct cpu *c = mycpu();
+
+  if (c->ticking || c->tickless) return 0;
+  c->ticking = 1;
+  clint_set_tick(r_time() + clint_interval());
+  return 1;
+}
+
+// p is RUNNING, perhaps on a hart with clock ticks off, which would
+// let it run on indefinitely: interrupt that hart and turn its ticks
+// back on. p->lock must be held.
+static void kick_running(struct proc *p) {
+  for (int i = 0; i < NCPU; i++) {
+    if (cpus[i].proc == p) {
+      __sync_bool_compare_and_swap(&cpus[i].tickless, 1, 0);
+      clint_send_ipi(i);
+    }
+  }
+}
+
+// Have every hart that runs with clock ticks off turn them back on.
+void wake_tickless_cpus(void) {
+  for (int i = 0; i < NCPU; i++)
+    if (__sync_bool_compare_and_swap(&cpus[i].tickless, 1, 0))
+      clint_send_ipi(i);
+}
+
+// Set the time slice, the time between clock ticks, to us microseconds,
+// unless us is 0. Returns the old slice, or -1 if us is out of range.
+int sched_slice(int us) {
+  uint64 per_us = CLINT_FREQ / 1000000;
+  int old = clint_interval() / per_us;
+
+  if (us == 0) return old;
+  if (us < 100 || us > 10000000) return -1;
+  clint_set_interval(us * per_us);
+  return old;
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -480,28 +885,35 @@ void scheduler(void) {
   //  and then reorders all processes.
   struct proc *p;
   struct cpu *c = mycpu();
-  int sched_rounds = 0;
+  int found;
+  uint64 hart = 1UL << cpuid();
 
   c->proc = 0;
+  c->start_time = r_time();
+  c->ticking = 1;
+  __sync_fetch_and_or(&cpus_online, hart);
   for (;;) {
-    // Maybe there are some processes waiting to be freed?
-    if (++sched_rounds == 1000) {
-      sched_rounds = 0;
-      free_pool(1);
-    }
-    int proc_number = proc_list_size();
+    // Free the processes no other hart can be looking at anymore.
+    epoch_poll();
 
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
+    found = 0;
+    epoch_enter();
+    int proc_number = proc_list_size();
     for (int i = 0; i < proc_number; i++) {
       if ((p = claim_proc(i)) == 0) continue;
 
       acquire(&p->lock);
-      if (p->state == RUNNABLE) {
+      if (p->state == RUNNABLE && (p->affinity & hart)) {
         // Switch to chosen process.  It is the process's job
         // to release its lock and then reacquire it
         // before jumping back to us.
+        found = 1;
+        uint64 now = r_time();
+        p->ru.lat_hist[lat_bucket(now - p->state_time)]++;
+        account(p, &p->ru.wait_time, now);
         p->state = RUNNING;
         c->proc = p;
 
@@ -511,16 +923,24 @@ void scheduler(void) {
         //  on this hart. Bitmask, for example
         sfence_vma_va(p->kstack);
 
+        update_ticks(c, hart);
+        count_event(EV_SWITCH);
+
+        // p->lock keeps p alive until it comes back, so don't hold up
+        // reclamation while it runs.
+        epoch_exit();
         swtch(&c->context, &p->context);
+        epoch_enter();
 
         // Process is done running for now.
         // It should have changed its p->state before coming back.
         c->proc = 0;
       }
       release(&p->lock);
-
-      stop_watching_proc(p);
     }
+    epoch_exit();
+
+    if (!found) idle(c);
   }
 }
 
@@ -540,6 +960,12 @@ void sched(void) {
   if (p->state == RUNNING) panic("sched running");
   if (intr_get()) panic("sched interruptible");
 
+  account(p, &p->ru.cpu_time, r_time());
+  if (p->state == RUNNABLE)
+    p->ru.nivcsw++;
+  else
+    p->ru.nvcsw++;
+
   intena = mycpu()->intena;
   swtch(&p->context, &mycpu()->context);
   mycpu()->intena = intena;
@@ -550,6 +976,9 @@ void yield(void) {
   struct proc *p = myproc();
   acquire(&p->lock);
   p->state = RUNNABLE;
+  // Pinned off this hart: an allowed hart may be idle with its
+  // tick off, and nothing else will ever wake it for us.
+  if (!(p->affinity & (1UL << cpuid()))) wake_idle_cpu(p->affinity);
   sched();
   release(&p->lock);
 }
@@ -607,26 +1036,30 @@ void sleep(void *chan, struct spinlock *lk) {
 void wakeup(void *chan) {
   struct proc *p;
 
+  epoch_enter();
   int proc_number = proc_list_size();
 
   for (int i = 0; i < proc_number; i++) {
     if ((p = claim_proc(i)) == 0) continue;
 
     if (p != myproc()) {
+      uint64 woken = 0;
       acquire(&p->lock);
       if (p->state == SLEEPING && p->chan == chan) {
+        account(p, &p->ru.sleep_time, r_time());
         p->state = RUNNABLE;
+        woken = p->affinity;
       }
       release(&p->lock);
+      if (woken) wake_idle_cpu(woken);
     }
-    stop_watching_proc(p);
   }
+  epoch_exit();
 }
 
-// Kill the process with the given pid.
-// The victim won't exit until it tries to return
-// to user space (see usertrap() in trap.c).
-int kill(int pid) {
+// Find the process with the given pid and return it with p->lock held.
+// Must be called inside an epoch section.
+static struct proc *lock_proc_by_pid(int pid) {
   struct proc *p;
 
   int proc_number = proc_list_size();
@@ -635,20 +1068,109 @@ int kill(int pid) {
     if ((p = claim_proc(i)) == 0) continue;
 
     acquire(&p->lock);
-    if (p->pid == pid) {
-      p->killed = 1;
-      if (p->state == SLEEPING) {
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      stop_watching_proc(p);
-      return 0;
-    }
+    if (p->pid == pid) return p;
     release(&p->lock);
-    stop_watching_proc(p);
   }
-  return -1;
+  return 0;
+}
+
+// Kill the process with the given pid.
+// The victim won't exit until it tries to return
+// to user space (see usertrap() in trap.c).
+int kill(int pid) {
+  struct proc *p;
+  uint64 woken = 0;
+
+  epoch_enter();
+  if ((p = lock_proc_by_pid(pid)) == 0) {
+    epoch_exit();
+    return -1;
+  }
+  p->killed = 1;
+  if (p->state == SLEEPING) {
+    // Wake process from sleep().
+    account(p, &p->ru.sleep_time, r_time());
+    p->state = RUNNABLE;
+    woken = p->affinity;
+  } else if (p->state == RUNNING && p != myproc()) {
+    kick_running(p);
+  }
+  release(&p->lock);
+  epoch_exit();
+  if (woken) wake_idle_cpu(woken);
+  return 0;
+}
+
+// Allow the process with the given pid (0 for the caller) to run only on
+// the harts in mask. Harts that never started are dropped from the mask.
+// A process running elsewhere moves when it next gives up its hart.
+// Returns -1 if there's no such process or no usable hart in mask.
+int setaffinity(int pid, uint64 mask) {
+  struct proc *p;
+  int runnable;
+
+  mask &= cpus_online;
+  if (mask == 0) return -1;
+  if (pid == 0) pid = myproc()->pid;
+
+  epoch_enter();
+  if ((p = lock_proc_by_pid(pid)) == 0) {
+    epoch_exit();
+    return -1;
+  }
+  p->affinity = mask;
+  runnable = (p->state == RUNNABLE);
+  if (p->state == RUNNING && p != myproc()) kick_running(p);
+  release(&p->lock);
+  epoch_exit();
+
+  if (runnable) wake_idle_cpu(mask);
+
+  if (pid == myproc()->pid) {
+    push_off();
+    int allowed = (mask & (1UL << cpuid())) != 0;
+    pop_off();
+    // Move to an allowed hart right away.
+    if (!allowed) yield();
+  }
+  return 0;
+}
+
+// Store the harts the process with the given pid (0 for the caller)
+// may run on in *mask. Returns -1 if there's no such process.
+int getaffinity(int pid, uint64 *mask) {
+  struct proc *p;
+
+  if (pid == 0) pid = myproc()->pid;
+
+  epoch_enter();
+  if ((p = lock_proc_by_pid(pid)) == 0) {
+    epoch_exit();
+    return -1;
+  }
+  *mask = p->affinity & cpus_online;
+  release(&p->lock);
+  epoch_exit();
+  return 0;
+}
+
+// Turn system call tracing on or off for the process with the given
+// pid (0 for the caller). Its children inherit the setting.
+// Returns -1 if there's no such process.
+int settrace(int pid, int on) {
+  struct proc *p;
+
+  if (pid == 0) pid = myproc()->pid;
+
+  epoch_enter();
+  if ((p = lock_proc_by_pid(pid)) == 0) {
+    epoch_exit();
+    return -1;
+  }
+  p->trace = on != 0;
+  release(&p->lock);
+  epoch_exit();
+  return 0;
 }
 
 void setkilled(struct proc *p) {
@@ -666,13 +1188,67 @@ int killed(struct proc *p) {
   return k;
 }
 
+// Store the usage of the process with the given pid (0 for the caller)
+// in *ru. Returns -1 if there's no such process.
+int getrusage(int pid, struct rusage *ru) {
+  struct proc *p;
+
+  if (pid == 0) pid = myproc()->pid;
+
+  epoch_enter();
+  if ((p = lock_proc_by_pid(pid)) == 0) {
+    epoch_exit();
+    return -1;
+  }
+  proc_rusage(p, ru);
+  release(&p->lock);
+  epoch_exit();
+  return 0;
+}
+
+// Copy a struct procstat for each process, at most n of them, to the
+// user array at addr. Returns the number of entries copied, or -1.
+int procstat(uint64 addr, int n) {
+  struct proc *p;
+  struct procstat ps;
+  pagetable_t pagetable = myproc()->tg->pagetable;
+  int cnt = 0;
+
+  epoch_enter();
+  int proc_number = proc_list_size();
+
+  for (int i = 0; i < proc_number && cnt < n; i++) {
+    if ((p = claim_proc(i)) == 0) continue;
+
+    acquire(&p->lock);
+    if (p->state == UNUSED || p->state == USED) {
+      release(&p->lock);
+      continue;
+    }
+    ps.pid = p->pid;
+    ps.state = p->state;
+    safestrcpy(ps.name, p->name, sizeof(ps.name));
+    proc_rusage(p, &ps.ru);
+    release(&p->lock);
+
+    if (copyout(pagetable, addr + cnt * sizeof(ps), (char *)&ps,
+                sizeof(ps)) < 0) {
+      epoch_exit();
+      return -1;
+    }
+    cnt++;
+  }
+  epoch_exit();
+  return cnt;
+}
+
 // Copy to either a user address, or kernel address,
 // depending on usr_dst.
 // Returns 0 on success, -1 on error.
 int either_copyout(int user_dst, uint64 dst, void *src, uint64 len) {
   struct proc *p = myproc();
   if (user_dst) {
-    return copyout(p->pagetable, dst, src, len);
+    return copyout(p->tg->pagetable, dst, src, len);
   } else {
     memmove((char *)dst, src, len);
     return 0;
@@ -685,7 +1261,7 @@ int either_copyout(int user_dst, uint64 dst, void *src, uint64 len) {
 int either_copyin(void *dst, int user_src, uint64 src, uint64 len) {
   struct proc *p = myproc();
   if (user_src) {
-    return copyin(p->pagetable, dst, src, len);
+    return copyin(p->tg->pagetable, dst, src, len);
   } else {
     memmove(dst, (char *)src, len);
     return 0;
@@ -703,12 +1279,19 @@ void procdump(void) {
   char *state;
 
   printf("\n");
+  uint64 now = r_time();
+  for (int i = 0; i < NCPU; i++) {
+    struct cpu *c = &cpus[i];
+    if (c->start_time == 0 || now <= c->start_time) continue;
+    printf("hart %d: idle %d%%\n", i,
+           (int)(c->idle_time * 100 / (now - c->start_time)));
+  }
+  epoch_enter();
   int proc_number = proc_list_size();
-  print_pool();
   printf("Proc seek len is %d\n", proc_number);
 
   for (int i = 0; i < proc_number; i++) {
-    p = (struct proc *)v_get(&proc_list.proc, i);
+    p = claim_proc(i);
 
     if (p == 0) continue;
 
@@ -721,4 +1304,5 @@ void procdump(void) {
            p->list_index);
     printf("\n");
   }
+  epoch_exit();
 }
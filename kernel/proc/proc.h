@@ -4,7 +4,11 @@
 #include "../param.h"
 #include "../riscv.h"
 #include "../types.h"
+#include "../util/epoch.h"
+#include "../util/sleeplock.h"
 #include "../util/spinlock.h"
+#include "procstat.h"
+#include "usysdata.h"
 
 // Saved registers for kernel context switches.
 struct context {
@@ -28,10 +32,17 @@ struct context {
 
 // Per-CPU state.
 struct cpu {
-  struct proc *proc;       // The process running on this cpu, or null.
-  struct context context;  // swtch() here to enter scheduler().
-  int noff;                // Depth of push_off() nesting.
-  int intena;              // Were interrupts enabled before push_off()?
+  struct proc *proc;          // The process running on this cpu, or null.
+  struct context context;     // swtch() here to enter scheduler().
+  int noff;                   // Depth of push_off() nesting.
+  int intena;                 // Were interrupts enabled before push_off()?
+  int idle;                   // Is the hart waiting in wfi for work?
+  uint64 start_time;          // When scheduler() started on this hart.
+  uint64 idle_time;           // Time spent in wfi, in timer cycles.
+  int ticking;                // Are clock ticks on? See update_ticks().
+  int tickless;               // Running with ticks off; others may clear.
+  struct mcs_node mcs[NMCS];  // Queue nodes for SPIN_MCS locks.
+  uint mcs_used;              // Bitmask of mcs[] entries in use.
 };
 
 extern struct cpu cpus[NCPU];
@@ -89,6 +100,24 @@ struct trapframe {
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// State shared by the threads of a process, see clone().
+struct tgroup {
+  struct spinlock lock;
+
+  // lock must be held when using these:
+  int ref;       // Procs using the group
+  int nlive;     // Threads that haven't exited
+  uint64 slots;  // Bitmask of used TRAPFRAME_SLOT()s
+
+  uint64 sz;                   // Size of process memory (bytes)
+  pagetable_t pagetable;       // User page table
+  struct file *ofile[NOFILE];  // Open files
+  struct inode *cwd;           // Current directory
+  struct uthread *uthreads;    // USYSTHREADS page
+  struct uring *ring;          // USYSRING page, or 0
+  struct sleeplock ringlock;   // Serializes ring_enter()
+};
+
 // Per-process state
 struct proc {
   struct spinlock lock;
@@ -99,22 +128,25 @@ struct proc {
   int killed;            // If non-zero, have been killed
   int xstate;            // Exit status to be returned to parent's wait
   int pid;               // Process ID
+  uint64 affinity;       // Bitmask of harts the process may run on
+  int trace;             // Log system calls, see sysstat.c
+  uint64 state_time;     // CLINT_MTIME of the last state change
+  struct rusage ru;      // Usage, times in CLINT_MTIME ticks
 
   // wait_lock must be held when using this:
   struct proc *parent;  // Parent process
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;                // Virtual address of kernel stack
-  uint64 sz;                    // Size of process memory (bytes)
-  pagetable_t pagetable;        // User page table
+  struct tgroup *tg;            // Memory and files, shared with threads
+  int tslot;                    // TRAPFRAME_SLOT() of trapframe, or -1
   struct trapframe *trapframe;  // data page for trampoline.S
   struct context context;       // swtch() here to run process
-  struct file *ofile[NOFILE];   // Open files
-  struct inode *cwd;            // Current directory
   char name[16];                // Process name (debugging)
+  int ishared;                  // Inodes held via ilock_shared()
 
   int list_index;  // Index in proc table
-  int watching;
+  struct epoch_node epoch_node;  // for freeing p after it's unlinked
 };
 
 // swtch.S
@@ -123,10 +155,12 @@ void swtch(struct context *, struct context *);
 int cpuid(void);
 void exit(int);
 int fork(void);
-int growproc(int);
+int clone(uint64, uint64, uint64);
+int join(int, uint64);
+int growproc(int, uint64 *);
 void proc_mapstacks(pagetable_t);
 pagetable_t proc_pagetable(struct proc *);
-void proc_freepagetable(pagetable_t, uint64);
+void proc_freepagetable(pagetable_t, uint64, int);
 int kill(int);
 int killed(struct proc *);
 void setkilled(struct proc *);
@@ -140,6 +174,17 @@ void sleep(void *, struct spinlock *);
 void userinit(void);
 int wait(uint64);
 void wakeup(void *);
+void wake_idle_cpu(uint64);
+int resume_ticks(void);
+void wake_tickless_cpus(void);
+int sched_slice(int);
+int settrace(int, int);
+int setaffinity(int, uint64);
+int getaffinity(int, uint64 *);
+int getrusage(int, struct rusage *);
+struct spawn_action;
+int spawn(char *, char **, struct spawn_action *, struct file **, int);
+int procstat(uint64, int);
 void yield(void);
 int either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int either_copyin(void *dst, int user_src, uint64 src, uint64 len);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../types.h"
+
+#define RUSAGE_LAT_BUCKETS 20
+
+// Resource usage of a process. Times are in microseconds.
+struct rusage {
+  uint64 cpu_time;    // Time spent running
+  uint64 wait_time;   // Time spent runnable, waiting for a hart
+  uint64 sleep_time;  // Time spent sleeping
+  uint64 nvcsw;       // Voluntary context switches (sleep, exit)
+  uint64 nivcsw;      // Involuntary context switches (yield)
+  // Run queue latency: bucket 0 counts waits under 1us, bucket i counts
+  // waits in [2^(i-1), 2^i) us, the last bucket counts everything longer.
+  uint64 lat_hist[RUSAGE_LAT_BUCKETS];
+};
+
+// One entry of the procstat() listing.
+struct procstat {
+  int pid;
+  int state;  // enum procstate
+  char name[16];
+  struct rusage ru;
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+// File actions for spawn(), applied in order to the child's copy of the
+// caller's open files.
+#define SPAWN_CLOSE 1  // Close fd
+#define SPAWN_DUP2 2   // Make newfd a copy of fd, closing newfd first
+#define SPAWN_OPEN 3   // Open path with omode as fd, closing fd first
+
+#define SPAWN_MAXACTS 16
+
+struct spawn_action {
+  int type;    // SPAWN_*
+  int fd;      // Descriptor to close, duplicate or open
+  int newfd;   // SPAWN_DUP2: where to put the copy of fd
+  int omode;   // SPAWN_OPEN: open mode, see fcntl.h
+  char *path;  // SPAWN_OPEN: file to open
+};
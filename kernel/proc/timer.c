@@ -0,0 +1,154 @@
+// Sleeping until a deadline.
+//
+// Each hart keeps a min-heap of the timers started on it, keyed by
+// deadline, and has timervec interrupt it at the earliest one. So a
+// sleeper is woken once, when its own deadline passes, rather than on
+// every clock tick. A timer lives on its sleeper's kernel stack.
+//
+// Deadlines are values of the time CSR, in CLINT_MTIME cycles.
+
+#include "timer.h"
+
+#include "../dev/clint.h"
+#include "../mem/kalloc.h"
+#include "../util/string.h"
+#include "proc.h"
+
+struct timer {
+  uint64 deadline;
+  int index;  // position in the heap, or -1 once it's out
+};
+
+struct {
+  struct spinlock lock;
+  struct timer **t;
+  int n;
+  int cap;
+} __attribute__((aligned(64))) heaps[NCPU];
+
+void timersinit(void) {
+  for (int i = 0; i < NCPU; i++) initlock(&heaps[i].lock, "timers");
+}
+
+static void heap_set(int h, int i, struct timer *t) {
+  heaps[h].t[i] = t;
+  t->index = i;
+}
+
+static void sift_up(int h, int i) {
+  struct timer **t = heaps[h].t;
+
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (t[parent]->deadline <= t[i]->deadline) break;
+    struct timer *x = t[i];
+    heap_set(h, i, t[parent]);
+    heap_set(h, parent, x);
+    i = parent;
+  }
+}
+
+static void sift_down(int h, int i) {
+  struct timer **t = heaps[h].t;
+  int n = heaps[h].n;
+
+  for (;;) {
+    int min = i, l = 2 * i + 1, r = 2 * i + 2;
+    if (l < n && t[l]->deadline < t[min]->deadline) min = l;
+    if (r < n && t[r]->deadline < t[min]->deadline) min = r;
+    if (min == i) break;
+    struct timer *x = t[i];
+    heap_set(h, i, t[min]);
+    heap_set(h, min, x);
+    i = min;
+  }
+}
+
+// Returns 0, or -1 if the heap couldn't grow.
+static int heap_push(int h, struct timer *t) {
+  if (heaps[h].n == heaps[h].cap) {
+    int cap = heaps[h].cap ? 2 * heaps[h].cap : 16;
+    struct timer **a = malloc(cap * sizeof(struct timer *));
+    if (a == 0) return -1;
+    if (heaps[h].t) {
+      memmove(a, heaps[h].t, heaps[h].n * sizeof(struct timer *));
+      kfree(heaps[h].t);
+    }
+    heaps[h].t = a;
+    heaps[h].cap = cap;
+  }
+  heap_set(h, heaps[h].n++, t);
+  sift_up(h, heaps[h].n - 1);
+  return 0;
+}
+
+static void heap_remove(int h, struct timer *t) {
+  int i = t->index;
+  struct timer *last = heaps[h].t[--heaps[h].n];
+
+  t->index = -1;
+  if (last != t) {
+    heap_set(h, i, last);
+    sift_up(h, i);
+    sift_down(h, last->index);
+  }
+}
+
+// Have this hart interrupted at heap h's earliest deadline.
+static void heap_arm(int h) {
+  clint_set_deadline(heaps[h].n ? heaps[h].t[0]->deadline : -1);
+}
+
+// Sleep until the time CSR reaches deadline.
+// Returns 0, or -1 if killed or out of memory.
+int timer_sleep(uint64 deadline) {
+  struct proc *p = myproc();
+  struct timer t;
+  int h;
+
+  if (deadline <= r_time()) return 0;
+  t.deadline = deadline;
+
+  // The timer goes in this hart's heap, and holding its lock keeps
+  // interrupts off, so we stay here until it's armed.
+  push_off();
+  h = cpuid();
+  acquire(&heaps[h].lock);
+  pop_off();
+  if (heap_push(h, &t) < 0) {
+    release(&heaps[h].lock);
+    return -1;
+  }
+  if (heaps[h].t[0] == &t) heap_arm(h);
+
+  while (t.index >= 0) {
+    if (killed(p)) {
+      heap_remove(h, &t);
+      release(&heaps[h].lock);
+      return -1;
+    }
+    sleep(&t, &heaps[h].lock);
+  }
+  release(&heaps[h].lock);
+  return 0;
+}
+
+// Wake the sleepers on this hart whose deadlines have passed, and arm
+// the next deadline. Called on each software interrupt, with interrupts
+// disabled.
+void timer_run(void) {
+  int h = cpuid();
+
+  // Only this hart adds timers to its heap.
+  if (__atomic_load_n(&heaps[h].n, __ATOMIC_RELAXED) == 0) return;
+
+  uint64 now = r_time();
+  acquire(&heaps[h].lock);
+  while (heaps[h].n > 0 && heaps[h].t[0]->deadline <= now) {
+    struct timer *t = heaps[h].t[0];
+    heap_remove(h, t);
+    wakeup(t);
+  }
+  heap_arm(h);
+  release(&heaps[h].lock);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "../types.h"
+
+void timersinit(void);
+int timer_sleep(uint64 deadline);
+void timer_run(void);
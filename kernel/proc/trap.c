@@ -1,15 +1,18 @@
 #include "trap.h"
 
+#include "../dev/clint.h"
 #include "../dev/plic.h"
 #include "../dev/uart.h"
 #include "../dev/virtio.h"
+#include "../events.h"
 #include "../mem/memlayout.h"
 #include "../printf.h"
 #include "../proc/proc.h"
 #include "../syscall.h"
+#include "timer.h"
+#include "vdso.h"
 
-struct spinlock tickslock;
-uint ticks;
+uint64 boot_time;  // time CSR when trapinit() ran
 
 extern char trampoline[], uservec[], userret[];
 
@@ -18,10 +21,18 @@ void kernelvec();
 
 extern int devintr();
 
-void trapinit(void) { initlock(&tickslock, "time"); }
+void trapinit(void) { boot_time = r_time(); }
+
+// clock ticks since boot. they're counted off the time CSR rather
+// than clock interrupts, which harts may turn off, see update_ticks().
+uint uptime_ticks(void) { return (r_time() - boot_time) / TICK_INTERVAL; }
 
 // set up to take exceptions and traps while in the kernel.
-void trapinithart(void) { w_stvec((uint64)kernelvec); }
+void trapinithart(void) {
+  w_stvec((uint64)kernelvec);
+  // let user space read the time CSR, see usysdata.h.
+  w_scounteren(r_scounteren() | 2);
+}
 
 //
 // handle an interrupt, exception, or system call from user space.
@@ -93,6 +104,11 @@ void usertrapret(void) {
   p->trapframe->kernel_trap = (uint64)usertrap;
   p->trapframe->kernel_hartid = r_tp();  // hartid for cpuid()
 
+  // point the user's tp at the thread's entry in the USYSTHREADS
+  // page, and record the hart there.
+  p->tg->uthreads[p->tslot].hartid = r_tp();
+  p->trapframe->tp = USYSTHREAD(p->tslot);
+
   // set up the registers that trampoline.S's sret will use
   // to get to user space.
 
@@ -105,14 +121,16 @@ void usertrapret(void) {
   // set S Exception Program Counter to the saved user pc.
   w_sepc(p->trapframe->epc);
 
-  // tell trampoline.S the user page table to switch to.
-  uint64 satp = MAKE_SATP(p->pagetable);
+  // tell trampoline.S the user page table to switch to,
+  // and where this thread's trapframe is mapped in it.
+  uint64 satp = MAKE_SATP(p->tg->pagetable);
+  uint64 trapframe = TRAPFRAME_SLOT(p->tslot);
 
   // jump to userret in trampoline.S at the top of memory, which
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 trampoline_userret = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64))trampoline_userret)(satp);
+  ((void (*)(uint64, uint64))trampoline_userret)(satp, trapframe);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -142,19 +160,15 @@ void kerneltrap() {
   w_sstatus(sstatus);
 }
 
-void clockintr() {
-  acquire(&tickslock);
-  ticks++;
-  wakeup(&ticks);
-  release(&tickslock);
-}
+void clockintr() { vdso_tick(cpuid()); }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
 // returns 2 if timer interrupt,
 // 1 if other device,
 // 0 if not recognized.
-int devintr() {
+// Not inlined, for prof_tick()'s stack walk.
+__attribute__((noinline)) int devintr() {
   uint64 scause = r_scause();
 
   if ((scause & 0x8000000000000000L) && (scause & 0xff) == 9) {
@@ -162,6 +176,7 @@ int devintr() {
 
     // irq indicates which device interrupted.
     int irq = plic_claim();
+    if (irq) count_event(EV_DEVINTR);
 
     if (irq == UART0_IRQ) {
       uartintr();
@@ -178,17 +193,27 @@ int devintr() {
 
     return 1;
   } else if (scause == 0x8000000000000001L) {
-    // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
-
-    if (cpuid() == 0) {
-      clockintr();
-    }
+    // software interrupt from a machine-mode timer interrupt
+    // or from an IPI, forwarded by timervec in kernelvec.S.
 
     // acknowledge the software interrupt by clearing
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
+    // either way, some of this hart's timers may be due.
+    timer_run();
+
+    if (!clint_tick_pending()) {
+      // an IPI; it only had to wake this hart from wfi, unless
+      // it's a nudge to turn clock ticks back on and preempt.
+      count_event(EV_IPI);
+      return resume_ticks() ? 2 : 1;
+    }
+
+    count_event(EV_TICK);
+    clockintr();
+    prof_tick();
+
     return 2;
   } else {
     return 0;
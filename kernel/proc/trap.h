@@ -2,8 +2,12 @@
 
 #include "../types.h"
 
-extern uint ticks;
+extern uint64 boot_time;
+uint uptime_ticks(void);
 void trapinit(void);
 void trapinithart(void);
-extern struct spinlock tickslock;
 void usertrapret(void);
+
+void profinit(void);
+int prof_active(void);
+void prof_tick(void);
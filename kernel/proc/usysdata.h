@@ -0,0 +1,22 @@
+#pragma once
+
+#include "../param.h"
+#include "../types.h"
+
+// Read-only pages the kernel maps into every user address space, so
+// user code can read the time, its pid and its hart without a trap.
+
+// At USYSDATA, one page shared by all processes.
+struct usysdata {
+  uint64 mtime_base;         // Value of the time CSR at boot
+  uint64 mtime_freq;         // Time CSR increments per second
+  uint64 tick_interval;      // Time CSR increments per uptime() tick
+  uint64 hart_ticks[NCPU];   // Clock interrupts each hart has taken
+};
+
+// At USYSTHREADS, one page per thread group, with an entry per thread.
+// The kernel points each thread's tp register at its own entry.
+struct uthread {
+  int pid;     // Thread's pid, as getpid()
+  int hartid;  // Hart the thread was last sent to user space on
+};
@@ -0,0 +1,50 @@
+// User-visible kernel data, see usysdata.h.
+//
+// The USYSDATA page is a single physical page mapped read-only into
+// every user page table. The USYSTHREADS page belongs to a thread group
+// and is mapped into its page table only.
+
+#include "vdso.h"
+
+#include "../mem/kalloc.h"
+#include "../mem/memlayout.h"
+#include "../mem/vm.h"
+#include "../printf.h"
+#include "trap.h"
+#include "../util/string.h"
+
+static struct usysdata *usysdata;
+
+void vdsoinit(void) {
+  if ((usysdata = (struct usysdata *)kalloc()) == 0) panic("vdsoinit");
+  memset(usysdata, 0, PGSIZE);
+  usysdata->mtime_base = boot_time;
+  usysdata->mtime_freq = CLINT_FREQ;
+  usysdata->tick_interval = TICK_INTERVAL;
+}
+
+// Count a clock interrupt on hart. Called by clockintr().
+void vdso_tick(int hart) {
+  __atomic_store_n(&usysdata->hart_ticks[hart],
+                   usysdata->hart_ticks[hart] + 1, __ATOMIC_RELAXED);
+}
+
+// Map the shared page and a group's uthreads page into pagetable.
+// Returns 0 on success, -1 on failure.
+int vdso_map(pagetable_t pagetable, struct uthread *uthreads) {
+  if (mappages(pagetable, USYSDATA, PGSIZE, (uint64)usysdata,
+               PTE_R | PTE_U) < 0)
+    return -1;
+  if (mappages(pagetable, USYSTHREADS, PGSIZE, (uint64)uthreads,
+               PTE_R | PTE_U) < 0) {
+    uvmunmap(pagetable, USYSDATA, 1, 0);
+    return -1;
+  }
+  return 0;
+}
+
+// Undo vdso_map(), leaving the pages themselves alone.
+void vdso_unmap(pagetable_t pagetable) {
+  uvmunmap(pagetable, USYSDATA, 1, 0);
+  uvmunmap(pagetable, USYSTHREADS, 1, 0);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "../riscv.h"
+#include "../types.h"
+#include "usysdata.h"
+
+void vdsoinit(void);
+void vdso_tick(int hart);
+int vdso_map(pagetable_t pagetable, struct uthread *uthreads);
+void vdso_unmap(pagetable_t pagetable);
@@ -0,0 +1,150 @@
+// Sampling profiler, see prof.h.
+//
+// On each clock tick devintr() calls prof_tick(), which walks the
+// interrupted code's frame pointers (the kernel and user programs are
+// built with -fno-omit-frame-pointer) and appends a sample to its
+// hart's buffer. Only that hart writes the buffer; readers of the PROF
+// device take samples out of it under readlock.
+
+#include "prof.h"
+
+#include "fs/file.h"
+#include "mem/memlayout.h"
+#include "mem/vm.h"
+#include "proc/proc.h"
+#include "proc/timer.h"
+#include "proc/trap.h"
+#include "util/string.h"
+
+#define NSAMPLE 64
+
+static struct {
+  struct prof_sample buf[NSAMPLE];
+  uint r;  // next sample to read
+  uint w;  // next sample to write
+} __attribute__((aligned(64))) cpubuf[NCPU];
+
+static struct spinlock readlock;
+static volatile int profiling;
+
+int prof_active(void) { return profiling; }
+
+// Follow the kernel frame pointer chain from fp, storing return
+// addresses in pc[]. Stays on fp's stack page, so it won't touch a
+// guard page. Returns the number stored.
+static int kernel_walk(uint64 fp, uint64 *pc, int max) {
+  uint64 page = PGROUNDDOWN(fp - 1);
+  int n = 0;
+
+  while (n < max && fp % 8 == 0 && PGROUNDDOWN(fp - 1) == page &&
+         fp - 16 >= page) {
+    uint64 next = ((uint64 *)fp)[-2];
+    pc[n++] = ((uint64 *)fp)[-1];
+    if (next <= fp) break;
+    fp = next;
+  }
+  return n;
+}
+
+// Same as kernel_walk() for a user frame pointer chain.
+static int user_walk(pagetable_t pagetable, uint64 fp, uint64 *pc,
+                     int max) {
+  uint64 frame[2];  // saved fp, return address
+  int n = 0;
+
+  while (n < max && fp % 8 == 0 && fp >= 16 &&
+         copyin(pagetable, (char *)frame, fp - 16, sizeof(frame)) == 0) {
+    pc[n++] = frame[1];
+    if (frame[0] <= fp) break;
+    fp = frame[0];
+  }
+  return n;
+}
+
+// Sample the code this clock tick interrupted. Called from devintr(),
+// with interrupts off. Never inlined, nor is devintr(), so that the
+// frame count below holds in optimized builds.
+__attribute__((noinline)) void prof_tick(void) {
+  if (!profiling) return;
+
+  int id = cpuid();
+  struct proc *p = myproc();
+  if (cpubuf[id].w - __atomic_load_n(&cpubuf[id].r, __ATOMIC_ACQUIRE) ==
+      NSAMPLE)
+    return;  // full; drop the sample
+  struct prof_sample *s = &cpubuf[id].buf[cpubuf[id].w % NSAMPLE];
+
+  s->pid = p ? p->pid : 0;
+  s->hart = id;
+  safestrcpy(s->name, p ? p->name : "", sizeof(s->name));
+  s->pc[0] = r_sepc();
+  s->user = (r_sstatus() & SSTATUS_SPP) == 0;
+  if (s->user) {
+    s->depth = 1 + user_walk(p->tg->pagetable, p->trapframe->s0, s->pc + 1,
+                             PROF_DEPTH - 1);
+  } else {
+    // We were called by devintr(), called by kerneltrap(), called by
+    // kernelvec, which leaves s0 alone: the third saved s0 up the
+    // chain is the interrupted code's.
+    uint64 fp = r_fp();
+    for (int i = 0; i < 3; i++) fp = ((uint64 *)fp)[-2];
+    s->depth = 1 + kernel_walk(fp, s->pc + 1, PROF_DEPTH - 1);
+  }
+  __atomic_store_n(&cpubuf[id].w, cpubuf[id].w + 1, __ATOMIC_RELEASE);
+}
+
+// Copy out as many whole samples as fit. While sampling is on, wait a
+// tick at a time for some to arrive; once it's off, return 0 at the end.
+static int profread(int user_dst, uint64 dst, int n) {
+  int got = 0;
+
+  acquire(&readlock);
+  for (;;) {
+    for (int c = 0; c < NCPU; c++) {
+      uint w = __atomic_load_n(&cpubuf[c].w, __ATOMIC_ACQUIRE);
+      while (cpubuf[c].r != w && got + sizeof(struct prof_sample) <= n) {
+        struct prof_sample *s = &cpubuf[c].buf[cpubuf[c].r % NSAMPLE];
+        if (either_copyout(user_dst, dst + got, s, sizeof(*s)) < 0) {
+          release(&readlock);
+          return -1;
+        }
+        __atomic_store_n(&cpubuf[c].r, cpubuf[c].r + 1, __ATOMIC_RELEASE);
+        got += sizeof(*s);
+      }
+    }
+    if (got > 0 || !profiling) break;
+    release(&readlock);
+    if (timer_sleep(r_time() + TICK_INTERVAL) < 0) return -1;
+    acquire(&readlock);
+  }
+  release(&readlock);
+  return got;
+}
+
+// "1" throws away old samples and starts sampling, "0" stops.
+static int profwrite(int user_src, uint64 src, int n) {
+  char c;
+
+  if (n < 1 || either_copyin(&c, user_src, src, 1) < 0) return -1;
+  if (c == '1') {
+    acquire(&readlock);
+    profiling = 0;
+    for (int i = 0; i < NCPU; i++)
+      cpubuf[i].r = __atomic_load_n(&cpubuf[i].w, __ATOMIC_ACQUIRE);
+    profiling = 1;
+    release(&readlock);
+    // Samples are taken on clock ticks.
+    wake_tickless_cpus();
+  } else if (c == '0') {
+    profiling = 0;
+  } else {
+    return -1;
+  }
+  return n;
+}
+
+void profinit(void) {
+  initlock(&readlock, "prof");
+  devsw[PROF].read = profread;
+  devsw[PROF].write = profwrite;
+}
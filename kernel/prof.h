@@ -0,0 +1,18 @@
+#pragma once
+
+#include "types.h"
+
+// Samples of the code running at timer interrupts, read from the PROF
+// device. Writing "1" to the device starts sampling, "0" stops it.
+
+#define PROF_DEPTH 16
+
+struct prof_sample {
+  int pid;  // 0 if the hart had no process
+  int hart;
+  int user;   // Was the hart in user mode?
+  int depth;  // Entries used in pc[]
+  char name[16];
+  // Interrupted pc, then return addresses from the frame pointer chain.
+  uint64 pc[PROF_DEPTH];
+};
@@ -0,0 +1,131 @@
+// Batched system calls through a ring shared with user space, see
+// uring.h.
+//
+// ring_enter() runs each queued call through syscall_run(), with the
+// call's arguments swapped into the trapframe, so one trap serves a
+// whole batch and each call still shows up in sysstat and strace under
+// its own number. Threads of a group share the ring and take turns on
+// tg->ringlock.
+
+#include "ring.h"
+
+#include "mem/kalloc.h"
+#include "mem/memlayout.h"
+#include "mem/vm.h"
+#include "proc/proc.h"
+#include "syscall.h"
+#include "syscall_numbers.h"
+#include "uring.h"
+#include "util/string.h"
+
+// Map the calling thread group's ring at USYSRING, if it isn't yet.
+// Returns USYSRING, or -1 if out of memory.
+uint64 ring_setup(void) {
+  struct tgroup *tg = myproc()->tg;
+  struct uring *r;
+
+  if ((r = kalloc()) == 0) return -1;
+  memset(r, 0, PGSIZE);
+
+  acquire(&tg->lock);
+  if (tg->ring == 0) {
+    if (mappages(tg->pagetable, USYSRING, PGSIZE, (uint64)r,
+                 PTE_R | PTE_W | PTE_U) < 0) {
+      release(&tg->lock);
+      kfree(r);
+      return -1;
+    }
+    tg->ring = r;
+    r = 0;
+  }
+  release(&tg->lock);
+
+  if (r) kfree(r);
+  return USYSRING;
+}
+
+// Calls that don't return to their caller, or that copy or replace the
+// trapframe they were called with, can't be run from the ring.
+static int ring_allowed(int op) {
+  switch (op) {
+    case SYS_fork:
+    case SYS_exit:
+    case SYS_exec:
+    case SYS_clone:
+    case SYS_ring_setup:
+    case SYS_ring_enter:
+      return 0;
+  }
+  return 1;
+}
+
+// Run sqe as if the calling thread had trapped into it.
+static uint64 ring_run(struct ring_sqe *sqe) {
+  struct trapframe *tf = myproc()->trapframe;
+
+  if (syscall_handler(sqe->op) == 0 || !ring_allowed(sqe->op)) return -1;
+  tf->a0 = sqe->args[0];
+  tf->a1 = sqe->args[1];
+  tf->a2 = sqe->args[2];
+  tf->a3 = sqe->args[3];
+  tf->a4 = sqe->args[4];
+  tf->a5 = sqe->args[5];
+  return syscall_run(sqe->op);
+}
+
+// Run up to n queued calls, stopping early if the completion ring
+// fills up. Returns the number of calls run, or -1 if there's no ring.
+int ring_enter(int n) {
+  struct proc *p = myproc();
+  struct tgroup *tg = p->tg;
+  struct trapframe *tf = p->trapframe;
+  struct uring *r = tg->ring;
+  struct ring_sqe sqe;
+  struct ring_cqe *cqe;
+  int done = 0;
+
+  // The ring stays mapped while any thread of the group lives, since
+  // exec() only runs in a group of one.
+  if (r == 0) return -1;
+
+  // The handlers find their arguments in the trapframe, so keep ours.
+  uint64 a[6] = {tf->a0, tf->a1, tf->a2, tf->a3, tf->a4, tf->a5};
+
+  acquiresleep(&tg->ringlock);
+  while (done < n && !killed(p)) {
+    uint head = r->sq_head;
+    if (head == __atomic_load_n(&r->sq_tail, __ATOMIC_ACQUIRE)) break;
+    uint tail = r->cq_tail;
+    if (tail - __atomic_load_n(&r->cq_head, __ATOMIC_ACQUIRE) >=
+        RING_ENTRIES)
+      break;
+
+    // User space may scribble on the entry meanwhile; use a copy.
+    sqe = r->sq[head % RING_ENTRIES];
+    __atomic_store_n(&r->sq_head, head + 1, __ATOMIC_RELEASE);
+
+    cqe = &r->cq[tail % RING_ENTRIES];
+    cqe->res = ring_run(&sqe);
+    cqe->user_data = sqe.user_data;
+    __atomic_store_n(&r->cq_tail, tail + 1, __ATOMIC_RELEASE);
+    done++;
+  }
+  releasesleep(&tg->ringlock);
+
+  tf->a0 = a[0];
+  tf->a1 = a[1];
+  tf->a2 = a[2];
+  tf->a3 = a[3];
+  tf->a4 = a[4];
+  tf->a5 = a[5];
+  return done;
+}
+
+// Unmap and free tg's ring, if it has one. Called when tg's page table
+// is about to go away, with no other thread of tg left.
+void ring_free(struct tgroup *tg) {
+  if (tg->ring == 0) return;
+  uvmunmap(tg->pagetable, USYSRING, 1, 0);
+  kfree(tg->ring);
+  tg->ring = 0;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "types.h"
+
+struct tgroup;
+
+uint64 ring_setup(void);
+int ring_enter(int n);
+void ring_free(struct tgroup *tg);
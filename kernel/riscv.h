@@ -193,6 +193,24 @@ static inline uint64 r_mcounteren() {
   return x;
 }
 
+// Supervisor Counter-Enable
+static inline void w_scounteren(uint64 x) {
+  asm volatile("csrw scounteren, %0" : : "r"(x));
+}
+
+static inline uint64 r_scounteren() {
+  uint64 x;
+  asm volatile("csrr %0, scounteren" : "=r"(x));
+  return x;
+}
+
+// cycles executed by this hart
+static inline uint64 r_cycle() {
+  uint64 x;
+  asm volatile("csrr %0, cycle" : "=r"(x));
+  return x;
+}
+
 // machine-mode cycle counter
 static inline uint64 r_time() {
   uint64 x;
@@ -218,6 +236,13 @@ static inline uint64 r_sp() {
   return x;
 }
 
+// frame pointer, with -fno-omit-frame-pointer
+static inline uint64 r_fp() {
+  uint64 x;
+  asm volatile("mv %0, s0" : "=r"(x));
+  return x;
+}
+
 // read and write tp, the thread pointer, which xv6 uses to hold
 // this core's hartid (core number), the index into cpus[].
 static inline uint64 r_tp() {
@@ -244,6 +269,9 @@ static inline void sfence_vma_va(uint64 va) {
   asm volatile("sfence.vma %0, zero" : : "r"(va));
 }
 
+// stall the hart until an interrupt is pending.
+static inline void wfi() { asm volatile("wfi"); }
+
 typedef uint64 pte_t;
 typedef uint64 *pagetable_t;  // 512 PTEs
 
@@ -9,8 +9,8 @@ void timerinit();
 // entry.S needs one stack per CPU.
 __attribute__((aligned(16))) char stack0[4096 * NCPU];
 
-// a scratch area per CPU for machine-mode timer interrupts.
-uint64 timer_scratch[NCPU][5];
+// a scratch area per CPU for machine-mode timer and software interrupts.
+uint64 timer_scratch[NCPU][10];
 
 // assembly code in kernelvec.S for machine-mode timer interrupt.
 extern void timervec();
@@ -40,6 +40,9 @@ void start() {
   w_pmpaddr0(0x3fffffffffffffull);
   w_pmpcfg0(0xf);
 
+  // allow supervisor mode to read the cycle and time CSRs.
+  w_mcounteren(r_mcounteren() | 3);
+
   // ask for clock interrupts.
   timerinit();
 
@@ -55,22 +58,34 @@ void start() {
 // they will arrive in machine mode at
 // at timervec in kernelvec.S,
 // which turns them into software interrupts for
-// devintr() in trap.c.
+// devintr() in trap.c. IPIs from other harts take
+// the same path.
 void timerinit() {
   // each CPU has a separate source of timer interrupts.
   int id = r_mhartid();
 
   // ask the CLINT for a timer interrupt.
-  int interval = 1000000;  // cycles; about 1/10th second in qemu.
-  *(uint64 *)CLINT_MTIMECMP(id) = *(uint64 *)CLINT_MTIME + interval;
+  int interval = TICK_INTERVAL;
+  uint64 next = *(uint64 *)CLINT_MTIME + interval;
+  *(uint64 *)CLINT_MTIMECMP(id) = next;
 
   // prepare information in scratch[] for timervec.
   // scratch[0..2] : space for timervec to save registers.
   // scratch[3] : address of CLINT MTIMECMP register.
   // scratch[4] : desired interval (in cycles) between timer interrupts.
+  // scratch[5] : set by timervec when it forwards a clock tick.
+  // scratch[6] : address of CLINT MSIP register.
+  // scratch[7] : time of the next clock tick.
+  // scratch[8] : one-off interrupt time from clint_set_deadline(), or -1.
+  // scratch[9] : address of CLINT MTIME register.
   uint64 *scratch = &timer_scratch[id][0];
   scratch[3] = CLINT_MTIMECMP(id);
   scratch[4] = interval;
+  scratch[5] = 0;
+  scratch[6] = CLINT_MSIP(id);
+  scratch[7] = next;
+  scratch[8] = -1;
+  scratch[9] = CLINT_MTIME;
   w_mscratch((uint64)scratch);
 
   // set the machine-mode trap handler.
@@ -79,6 +94,7 @@ void timerinit() {
   // enable machine-mode interrupts.
   w_mstatus(r_mstatus() | MSTATUS_MIE);
 
-  // enable machine-mode timer interrupts.
-  w_mie(r_mie() | MIE_MTIE);
+  // enable machine-mode timer interrupts, and software
+  // interrupts, which other harts use as IPIs.
+  w_mie(r_mie() | MIE_MTIE | MIE_MSIE);
 }
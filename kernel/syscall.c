@@ -1,5 +1,6 @@
 #include "syscall.h"
 
+#include "events.h"
 #include "mem/vm.h"
 #include "proc/proc.h"
 #include "util/string.h"
@@ -10,10 +11,10 @@
 // Fetch the uint64 at addr from the current process.
 int fetchaddr(uint64 addr, uint64 *ip) {
   struct proc *p = myproc();
-  if (addr >= p->sz ||
-      addr + sizeof(uint64) > p->sz)  // both tests needed, in case of overflow
+  // both tests needed, in case of overflow
+  if (addr >= p->tg->sz || addr + sizeof(uint64) > p->tg->sz) return -1;
+  if (copyin(p->tg->pagetable, (char *)ip, addr, sizeof(*ip)) != 0)
     return -1;
-  if (copyin(p->pagetable, (char *)ip, addr, sizeof(*ip)) != 0) return -1;
   return 0;
 }
 
@@ -21,7 +22,7 @@ int fetchaddr(uint64 addr, uint64 *ip) {
 // Returns length of string, not including nul, or -1 for error.
 int fetchstr(uint64 addr, char *buf, int max) {
   struct proc *p = myproc();
-  if (copyinstr(p->pagetable, buf, addr, max) < 0) return -1;
+  if (copyinstr(p->tg->pagetable, buf, addr, max) < 0) return -1;
   return strlen(buf);
 }
 
@@ -85,6 +86,21 @@ extern uint64 sys_link(void);
 extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
 extern uint64 sys_havemem(void);
+extern uint64 sys_sched_setaffinity(void);
+extern uint64 sys_sched_getaffinity(void);
+extern uint64 sys_getrusage(void);
+extern uint64 sys_procstat(void);
+extern uint64 sys_spawn(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_futex_wait(void);
+extern uint64 sys_futex_wake(void);
+extern uint64 sys_ring_setup(void);
+extern uint64 sys_ring_enter(void);
+extern uint64 sys_nanosleep(void);
+extern uint64 sys_sched_slice(void);
+extern uint64 sys_trace(void);
+extern uint64 sys_lockbench(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -97,19 +113,55 @@ static uint64 (*syscalls[])(void) = {
     [SYS_write] sys_write, [SYS_mknod] sys_mknod,   [SYS_unlink] sys_unlink,
     [SYS_link] sys_link,   [SYS_mkdir] sys_mkdir,   [SYS_close] sys_close,
     [SYS_havemem] sys_havemem,
+    [SYS_sched_setaffinity] sys_sched_setaffinity,
+    [SYS_sched_getaffinity] sys_sched_getaffinity,
+    [SYS_getrusage] sys_getrusage,
+    [SYS_procstat] sys_procstat,
+    [SYS_spawn] sys_spawn,
+    [SYS_clone] sys_clone,
+    [SYS_join] sys_join,
+    [SYS_futex_wait] sys_futex_wait,
+    [SYS_futex_wake] sys_futex_wake,
+    [SYS_ring_setup] sys_ring_setup,
+    [SYS_ring_enter] sys_ring_enter,
+    [SYS_nanosleep] sys_nanosleep,
+    [SYS_sched_slice] sys_sched_slice,
+    [SYS_trace] sys_trace,
+    [SYS_lockbench] sys_lockbench,
 };
 
+// The function that handles system call num, or 0 if there's none.
+uint64 (*syscall_handler(int num))(void) {
+  if (num > 0 && num < NELEM(syscalls)) return syscalls[num];
+  return 0;
+}
+
+// Run system call num with its arguments in the trapframe, and record
+// it for sysstat and strace. Returns -1 if there's no such call.
+uint64 syscall_run(int num) {
+  struct proc *p = myproc();
+  uint64 (*fn)(void);
+
+  count_event(EV_SYSCALL);
+  if ((fn = syscall_handler(num)) == 0) return -1;
+
+  uint64 args[3] = {p->trapframe->a0, p->trapframe->a1, p->trapframe->a2};
+  uint64 t0 = r_time();
+  uint64 ret = fn();
+  uint64 time = r_time() - t0;
+  sysstat_record(num, ret, time);
+  if (p->trace) trace_record(p, num, args, ret, time);
+  return ret;
+}
+
 void syscall(void) {
   int num;
   struct proc *p = myproc();
 
   num = p->trapframe->a7;
-  if (num > 0 && num < NELEM(syscalls) && syscalls[num]) {
-    // Use num to lookup the system call function for num, call it,
-    // and store its return value in p->trapframe->a0
-    p->trapframe->a0 = syscalls[num]();
-  } else {
+  if (syscall_handler(num) == 0)
     printf("%d %s: unknown sys call %d\n", p->pid, p->name, num);
-    p->trapframe->a0 = -1;
-  }
+  // Use num to lookup the system call function for num, call it,
+  // and store its return value in p->trapframe->a0
+  p->trapframe->a0 = syscall_run(num);
 }
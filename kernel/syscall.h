@@ -7,4 +7,12 @@ int argstr(int, char *, int);
 void argaddr(int, uint64 *);
 int fetchstr(uint64, char *, int);
 int fetchaddr(uint64, uint64 *);
+uint64 (*syscall_handler(int))(void);
+uint64 syscall_run(int);
 void syscall();
+
+struct proc;
+void sysstatinit(void);
+void sysstat_record(int num, uint64 ret, uint64 time);
+void trace_record(struct proc *p, int num, uint64 *args, uint64 ret,
+                  uint64 time);
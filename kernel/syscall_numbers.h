@@ -24,4 +24,19 @@
 #define SYS_link 19
 #define SYS_mkdir 20
 #define SYS_close 21
-#define SYS_havemem 22
\ No newline at end of file
+#define SYS_havemem 22
+#define SYS_sched_setaffinity 23
+#define SYS_sched_getaffinity 24
+#define SYS_getrusage 25
+#define SYS_procstat 26
+#define SYS_spawn 27
+#define SYS_clone 28
+#define SYS_join 29
+#define SYS_futex_wait 30
+#define SYS_futex_wake 31
+#define SYS_ring_setup 32
+#define SYS_ring_enter 33
+#define SYS_nanosleep 34
+#define SYS_sched_slice 35
+#define SYS_trace 36
+#define SYS_lockbench 37
\ No newline at end of file
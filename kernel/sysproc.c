@@ -1,6 +1,12 @@
+#include "mem/memlayout.h"
+#include "mem/vm.h"
+#include "proc/futex.h"
 #include "proc/proc.h"
+#include "proc/timer.h"
 #include "proc/trap.h"
+#include "ring.h"
 #include "util/spinlock.h"
+#include "util/string.h"
 #include "syscall.h"
 #include "types.h"
 
@@ -21,32 +27,46 @@ uint64 sys_wait(void) {
   return wait(p);
 }
 
+uint64 sys_clone(void) {
+  uint64 fn, arg, stack;
+  argaddr(0, &fn);
+  argaddr(1, &arg);
+  argaddr(2, &stack);
+  return clone(fn, arg, stack);
+}
+
+uint64 sys_join(void) {
+  int pid;
+  uint64 p;
+  argint(0, &pid);
+  argaddr(1, &p);
+  return join(pid, p);
+}
+
 uint64 sys_sbrk(void) {
   uint64 addr;
   int n;
 
   argint(0, &n);
-  addr = myproc()->sz;
-  if (growproc(n) < 0) return -1;
+  if (growproc(n, &addr) < 0) return -1;
   return addr;
 }
 
 uint64 sys_sleep(void) {
   int n;
-  uint ticks0;
 
   argint(0, &n);
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while (ticks - ticks0 < n) {
-    if (killed(myproc())) {
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  if (n <= 0) return 0;
+  return timer_sleep(r_time() + (uint64)n * TICK_INTERVAL);
+}
+
+// Sleep for at least ns nanoseconds.
+uint64 sys_nanosleep(void) {
+  uint64 ns;
+  uint64 ns_per_cycle = 1000000000 / CLINT_FREQ;
+
+  argaddr(0, &ns);
+  return timer_sleep(r_time() + (ns + ns_per_cycle - 1) / ns_per_cycle);
 }
 
 uint64 sys_kill(void) {
@@ -56,13 +76,122 @@ uint64 sys_kill(void) {
   return kill(pid);
 }
 
-// return how many clock tick interrupts have occurred
-// since start.
-uint64 sys_uptime(void) {
-  uint xticks;
+// return how many clock ticks have passed since start.
+uint64 sys_uptime(void) { return uptime_ticks(); }
 
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
+uint64 sys_sched_setaffinity(void) {
+  int pid;
+  uint64 mask;
+
+  argint(0, &pid);
+  argaddr(1, &mask);
+  return setaffinity(pid, mask);
+}
+
+uint64 sys_sched_getaffinity(void) {
+  int pid;
+  uint64 addr, mask;
+
+  argint(0, &pid);
+  argaddr(1, &addr);
+  if (getaffinity(pid, &mask) < 0) return -1;
+  if (copyout(myproc()->tg->pagetable, addr, (char *)&mask, sizeof(mask)) < 0)
+    return -1;
+  return 0;
+}
+
+uint64 sys_getrusage(void) {
+  int pid;
+  uint64 addr;
+  struct rusage ru;
+
+  argint(0, &pid);
+  argaddr(1, &addr);
+  if (getrusage(pid, &ru) < 0) return -1;
+  if (copyout(myproc()->tg->pagetable, addr, (char *)&ru, sizeof(ru)) < 0)
+    return -1;
+  return 0;
+}
+
+uint64 sys_procstat(void) {
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return procstat(addr, n);
+}
+
+uint64 sys_futex_wait(void) {
+  uint64 addr;
+  int val;
+
+  argaddr(0, &addr);
+  argint(1, &val);
+  return futex_wait(addr, val);
+}
+
+uint64 sys_futex_wake(void) {
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return futex_wake(addr, n);
+}
+
+uint64 sys_ring_setup(void) { return ring_setup(); }
+
+uint64 sys_ring_enter(void) {
+  int n;
+
+  argint(0, &n);
+  return ring_enter(n);
+}
+
+uint64 sys_sched_slice(void) {
+  int us;
+
+  argint(0, &us);
+  return sched_slice(us);
+}
+
+uint64 sys_trace(void) {
+  int pid, on;
+
+  argint(0, &pid);
+  argint(1, &on);
+  return settrace(pid, on);
+}
+
+// One lock of each spintype for lockbench, shared by all callers.
+static struct {
+  struct spinlock lock;
+  uint64 count;  // Touched in the critical section.
+} __attribute__((aligned(64))) bench[] = {
+    [SPIN_TAS] = {.lock = {.name = "bench_tas", .type = SPIN_TAS}},
+    [SPIN_TICKET] = {.lock = {.name = "bench_ticket", .type = SPIN_TICKET}},
+    [SPIN_MCS] = {.lock = {.name = "bench_mcs", .type = SPIN_MCS}},
+};
+
+// lockbench(type, end_us): acquire and release the bench lock of the
+// given type until end_us microseconds after boot, at most 10 seconds
+// from now, and return how many times this caller got it.
+uint64 sys_lockbench(void) {
+  int type;
+  uint64 end_us, end, n = 0;
+
+  argint(0, &type);
+  argaddr(1, &end_us);
+  if (type < 0 || type >= NELEM(bench)) return -1;
+  end = boot_time + end_us * (CLINT_FREQ / 1000000);
+  if (end > r_time() + 10 * CLINT_FREQ) return -1;
+
+  while (r_time() < end && !killed(myproc())) {
+    acquire(&bench[type].lock);
+    bench[type].count++;
+    release(&bench[type].lock);
+    n++;
+  }
+  return n;
 }
@@ -0,0 +1,123 @@
+// System call statistics and tracing, see sysstat.h.
+//
+// Each hart counts the calls that finish on it in its own table, with
+// interrupts off and no lock; reading the SYSSTAT device sums the
+// tables. Calls made by traced processes also go to a ring buffer read
+// through the STRACE device, overwriting the oldest records when full.
+
+#include "sysstat.h"
+
+#include "fs/file.h"
+#include "proc/proc.h"
+#include "syscall.h"
+#include "syscall_numbers.h"
+#include "util/string.h"
+
+#define NTRACE 256
+
+static struct {
+  struct sysstat s[SYSSTAT_NSYSCALL];
+} __attribute__((aligned(64))) stats[NCPU];
+
+static struct {
+  struct spinlock lock;
+  struct trace_rec rec[NTRACE];
+  uint r;  // next record to read
+  uint w;  // next record to write
+} trace;
+
+static int lat_bucket(uint64 t) {
+  int b = 0;
+  while (t > 0 && b < SYSSTAT_BUCKETS - 1) {
+    t >>= 1;
+    b++;
+  }
+  return b;
+}
+
+// Count a call to num that returned ret after time cycles.
+void sysstat_record(int num, uint64 ret, uint64 time) {
+  if (num < 0 || num >= SYSSTAT_NSYSCALL) return;
+
+  push_off();
+  struct sysstat *s = &stats[cpuid()].s[num];
+  s->calls++;
+  if (ret == -1) s->errors++;
+  s->time += time;
+  s->hist[lat_bucket(time)]++;
+  pop_off();
+}
+
+// Append a record of p's call to num to the trace ring.
+void trace_record(struct proc *p, int num, uint64 *args, uint64 ret,
+                  uint64 time) {
+  acquire(&trace.lock);
+  struct trace_rec *t = &trace.rec[trace.w++ % NTRACE];
+  t->pid = p->pid;
+  t->num = num;
+  memmove(t->args, args, sizeof(t->args));
+  t->ret = ret;
+  t->time = time;
+  if (trace.w - trace.r > NTRACE) trace.r = trace.w - NTRACE;
+  wakeup(&trace.r);
+  release(&trace.lock);
+}
+
+// Copy a snapshot of the summed tables to dst, as many whole entries as
+// fit in n bytes.
+static int sysstatread(int user_dst, uint64 dst, int n) {
+  struct sysstat sum;
+  int i;
+
+  for (i = 0; i < SYSSTAT_NSYSCALL && (i + 1) * sizeof(sum) <= n; i++) {
+    memset(&sum, 0, sizeof(sum));
+    for (int c = 0; c < NCPU; c++) {
+      struct sysstat *s = &stats[c].s[i];
+      sum.calls += s->calls;
+      sum.errors += s->errors;
+      sum.time += s->time;
+      for (int b = 0; b < SYSSTAT_BUCKETS; b++) sum.hist[b] += s->hist[b];
+    }
+    if (either_copyout(user_dst, dst + i * sizeof(sum), &sum, sizeof(sum)) <
+        0)
+      return -1;
+  }
+  return i * sizeof(sum);
+}
+
+// Any write resets the tables. A hart updating its table meanwhile may
+// keep part of its old counts.
+static int sysstatwrite(int user_src, uint64 src, int n) {
+  for (int c = 0; c < NCPU; c++) memset(stats[c].s, 0, sizeof(stats[c].s));
+  return n;
+}
+
+// Wait for trace records, then copy out as many whole ones as fit.
+static int straceread(int user_dst, uint64 dst, int n) {
+  struct trace_rec *t;
+  int got = 0;
+
+  acquire(&trace.lock);
+  while (trace.r == trace.w) {
+    if (killed(myproc())) {
+      release(&trace.lock);
+      return -1;
+    }
+    sleep(&trace.r, &trace.lock);
+  }
+  while (trace.r != trace.w && got + sizeof(*t) <= n) {
+    t = &trace.rec[trace.r % NTRACE];
+    if (either_copyout(user_dst, dst + got, t, sizeof(*t)) < 0) break;
+    trace.r++;
+    got += sizeof(*t);
+  }
+  release(&trace.lock);
+  return got;
+}
+
+void sysstatinit(void) {
+  initlock(&trace.lock, "trace");
+  devsw[SYSSTAT].read = sysstatread;
+  devsw[SYSSTAT].write = sysstatwrite;
+  devsw[STRACE].read = straceread;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "types.h"
+
+// System call statistics, read from the SYSSTAT device as an array of
+// SYSSTAT_NSYSCALL struct sysstat indexed by system call number.
+// Writing anything to the device resets them.
+
+#define SYSSTAT_NSYSCALL 64
+#define SYSSTAT_BUCKETS 24
+
+struct sysstat {
+  uint64 calls;
+  uint64 errors;  // Calls that returned -1
+  uint64 time;    // Total time in the handler, in time CSR cycles
+  // Latency histogram: bucket 0 counts calls under 1 cycle, bucket i
+  // calls in [2^(i-1), 2^i) cycles, the last bucket everything longer.
+  uint64 hist[SYSSTAT_BUCKETS];
+};
+
+// A system call made by a traced process, read from the STRACE device.
+// exit() shows up with its status in args[0] when the process exits.
+struct trace_rec {
+  int pid;
+  int num;         // SYS_* number
+  uint64 args[3];  // a0-a2 on entry
+  uint64 ret;
+  uint64 time;  // Time in the handler, in time CSR cycles
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "types.h"
+
+// Submission/completion rings shared between a thread group and the
+// kernel, mapped at USYSRING by ring_setup(). User space queues system
+// calls in sq and calls ring_enter() to run them; their results show up
+// in cq, where user space can reap them whenever it likes.
+//
+// The head and tail counters run freely; an entry's index is the
+// counter modulo RING_ENTRIES. Each side only writes its own counters.
+
+#define RING_ENTRIES 32
+
+struct ring_sqe {
+  int op;  // SYS_* number
+  int pad;
+  uint64 args[6];    // a0-a5
+  uint64 user_data;  // copied to the completion
+};
+
+struct ring_cqe {
+  uint64 user_data;  // from the submission
+  uint64 res;        // system call's return value
+};
+
+struct uring {
+  uint sq_head;  // next submission the kernel takes, written by the kernel
+  uint sq_tail;  // next free submission, written by user space
+  uint cq_head;  // next completion to reap, written by user space
+  uint cq_tail;  // next free completion, written by the kernel
+  uint pad[12];
+  struct ring_sqe sq[RING_ENTRIES];
+  struct ring_cqe cq[RING_ENTRIES];
+};
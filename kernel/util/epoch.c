@@ -0,0 +1,102 @@
+// Epoch-based reclamation.
+//
+// Readers walk shared structures (the proc list, for example) between
+// epoch_enter() and epoch_exit(), without locks or per-object reference
+// counts. Whoever unlinks an object passes it to epoch_retire() instead
+// of freeing it. The object is freed once the global epoch has advanced
+// twice after that, because by then every hart that could have seen it
+// has left its read-side critical section.
+//
+// The global epoch advances only when every hart inside a critical
+// section has observed the current value. Critical sections run with
+// interrupts off, so they can't migrate between harts and must not sleep.
+// Retired objects wait on a list of the hart that retired them, there is
+// no limit on how many can be pending.
+
+#include "epoch.h"
+
+#include "../param.h"
+#include "../printf.h"
+#include "../proc/proc.h"
+
+static volatile uint64 global_epoch;
+
+struct epoch_cpu {
+  volatile uint64 epoch;    // global epoch seen by the current reader
+  volatile int active;      // inside a read-side critical section?
+  int depth;                // epoch_enter() nesting
+  struct epoch_node *head;  // retired objects, oldest first
+  struct epoch_node *tail;
+} __attribute__((aligned(64)));
+
+static struct epoch_cpu epoch_cpus[NCPU];
+
+// Start a read-side critical section.
+// Objects reachable now won't be freed before the matching epoch_exit().
+void epoch_enter(void) {
+  push_off();
+  struct epoch_cpu *e = &epoch_cpus[cpuid()];
+  if (e->depth++ == 0) {
+    e->epoch = global_epoch;
+    e->active = 1;
+    // make the announcement visible before reading shared data.
+    __sync_synchronize();
+  }
+}
+
+void epoch_exit(void) {
+  struct epoch_cpu *e = &epoch_cpus[cpuid()];
+  if (e->depth < 1) panic("epoch_exit");
+  if (--e->depth == 0) {
+    // finish all reads of shared data first.
+    __sync_synchronize();
+    e->active = 0;
+  }
+  pop_off();
+}
+
+// Free n with fn once no reader can hold a reference to it.
+// The object must already be unreachable for new readers.
+void epoch_retire(struct epoch_node *n, void (*fn)(struct epoch_node *)) {
+  push_off();
+  struct epoch_cpu *e = &epoch_cpus[cpuid()];
+  n->next = 0;
+  n->free = fn;
+  n->epoch = global_epoch;
+  if (e->tail)
+    e->tail->next = n;
+  else
+    e->head = n;
+  e->tail = n;
+  pop_off();
+}
+
+// Advance the global epoch if every active reader has seen it.
+static void try_advance(void) {
+  uint64 g = global_epoch;
+
+  __sync_synchronize();
+  for (int i = 0; i < NCPU; i++) {
+    if (epoch_cpus[i].active && epoch_cpus[i].epoch != g) return;
+  }
+  __sync_bool_compare_and_swap(&global_epoch, g, g + 1);
+}
+
+// Free this hart's retired objects that are no longer visible to readers.
+// Must be called outside of a read-side critical section.
+void epoch_poll(void) {
+  struct epoch_node *n;
+
+  push_off();
+  struct epoch_cpu *e = &epoch_cpus[cpuid()];
+  if (e->depth != 0) panic("epoch_poll");
+  if (e->head) {
+    try_advance();
+    while ((n = e->head) != 0 && n->epoch + 2 <= global_epoch) {
+      e->head = n->next;
+      if (e->head == 0) e->tail = 0;
+      n->free(n);
+    }
+  }
+  pop_off();
+}
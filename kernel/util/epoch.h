@@ -0,0 +1,19 @@
+#pragma once
+
+#include "../types.h"
+
+// Embedded in objects that are freed through epoch_retire().
+struct epoch_node {
+  struct epoch_node *next;
+  uint64 epoch;                       // global epoch when retired
+  void (*free)(struct epoch_node *);  // frees the enclosing object
+};
+
+// Get the object a node is embedded in
+#define epoch_container(n, type, member) \
+  ((type *)((char *)(n) - __builtin_offsetof(type, member)))
+
+void epoch_enter(void);
+void epoch_exit(void);
+void epoch_retire(struct epoch_node *, void (*)(struct epoch_node *));
+void epoch_poll(void);
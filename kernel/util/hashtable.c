@@ -0,0 +1,189 @@
+// Intrusive hash table, see hashtable.h.
+//
+// A resize takes every bucket lock of the old array, moves the nodes
+// to a new one and publishes it. ht_lock() rechecks the array after
+// taking a bucket lock and starts over if it was replaced meanwhile.
+// It looks at the array inside an epoch section, so the array can't be
+// freed before it's done with it.
+
+#include "hashtable.h"
+
+#include "../mem/kalloc.h"
+#include "../printf.h"
+#include "epoch.h"
+
+struct ht_table {
+  struct epoch_node node;
+  int nbucket;  // a power of two
+  struct ht_bucket b[];
+};
+
+static struct ht_table *table_alloc(struct hashtable *ht, int nbucket) {
+  int n = 1;
+
+  while (n < nbucket) n *= 2;
+  struct ht_table *t = malloc(sizeof(*t) + n * sizeof(t->b[0]));
+  if (t == 0) return 0;
+  t->nbucket = n;
+  for (int i = 0; i < n; i++) {
+    initlock(&t->b[i].lock, ht->name);
+    t->b[i].head = 0;
+  }
+  return t;
+}
+
+static void table_free(struct epoch_node *n) {
+  kfree(epoch_container(n, struct ht_table, node));
+}
+
+static struct ht_bucket *bucket(struct ht_table *t, uint64 key) {
+  uint64 h = key * 0x9e3779b97f4a7c15UL;
+  return &t->b[(h ^ (h >> 32)) & (t->nbucket - 1)];
+}
+
+int ht_init(struct hashtable *ht, char *name, int nbucket) {
+  ht->name = name;
+  ht->count = 0;
+  initlock(&ht->resize_lock, "ht_resize");
+  ht->table = table_alloc(ht, nbucket > 0 ? nbucket : 1);
+  return ht->table ? 0 : -1;
+}
+
+void ht_destroy(struct hashtable *ht) {
+  if (ht->count != 0) panic("ht_destroy");
+  kfree(ht->table);
+  ht->table = 0;
+}
+
+struct ht_bucket *ht_lock(struct hashtable *ht, uint64 key) {
+  for (;;) {
+    epoch_enter();
+    struct ht_table *t = __atomic_load_n(&ht->table, __ATOMIC_ACQUIRE);
+    struct ht_bucket *b = bucket(t, key);
+    acquire(&b->lock);
+    // A resize can't replace t while we hold one of its locks.
+    if (__atomic_load_n(&ht->table, __ATOMIC_ACQUIRE) == t) {
+      epoch_exit();
+      return b;
+    }
+    release(&b->lock);
+    epoch_exit();
+  }
+}
+
+static int resize(struct hashtable *, int, int);
+
+// Double the table if it's overloaded. Failing is harmless.
+static void maybe_grow(struct hashtable *ht) {
+  // t may be replaced and freed once we stop holding a bucket lock.
+  epoch_enter();
+  struct ht_table *t = __atomic_load_n(&ht->table, __ATOMIC_ACQUIRE);
+  int n = t->nbucket;
+  epoch_exit();
+
+  if (__atomic_load_n(&ht->count, __ATOMIC_RELAXED) > HT_LOAD * n)
+    resize(ht, 2 * n, n);
+}
+
+void ht_unlock(struct hashtable *ht, struct ht_bucket *b) {
+  release(&b->lock);
+  maybe_grow(ht);
+}
+
+struct ht_node *ht_find(struct ht_bucket *b, uint64 key) {
+  struct ht_node *n = b->head;
+
+  while (n && n->key != key) n = n->next;
+  return n;
+}
+
+struct ht_node *ht_find_next(struct ht_node *n, uint64 key) {
+  for (n = n->next; n && n->key != key; n = n->next)
+    ;
+  return n;
+}
+
+void ht_add(struct hashtable *ht, struct ht_bucket *b, struct ht_node *n,
+            uint64 key) {
+  n->key = key;
+  n->next = b->head;
+  b->head = n;
+  __atomic_fetch_add(&ht->count, 1, __ATOMIC_RELAXED);
+}
+
+void ht_del(struct hashtable *ht, struct ht_bucket *b, struct ht_node *n) {
+  struct ht_node **pp;
+
+  for (pp = &b->head; *pp; pp = &(*pp)->next) {
+    if (*pp == n) {
+      *pp = n->next;
+      __atomic_fetch_sub(&ht->count, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  }
+  panic("ht_del");
+}
+
+void ht_insert(struct hashtable *ht, struct ht_node *n, uint64 key) {
+  struct ht_bucket *b = ht_lock(ht, key);
+  ht_add(ht, b, n, key);
+  ht_unlock(ht, b);
+}
+
+void ht_remove(struct hashtable *ht, struct ht_node *n) {
+  struct ht_bucket *b = ht_lock(ht, n->key);
+  ht_del(ht, b, n);
+  ht_unlock(ht, b);
+}
+
+int ht_foreach(struct hashtable *ht, int (*fn)(struct ht_node *, void *),
+               void *arg) {
+  int r = 0;
+
+  acquire(&ht->resize_lock);
+  struct ht_table *t = ht->table;
+  for (int i = 0; i < t->nbucket && r == 0; i++) {
+    acquire(&t->b[i].lock);
+    for (struct ht_node *n = t->b[i].head; n && r == 0; n = n->next)
+      r = fn(n, arg);
+    release(&t->b[i].lock);
+  }
+  release(&ht->resize_lock);
+  return r;
+}
+
+// Rehash into nbucket buckets, unless from is positive and the table
+// no longer has from buckets, because someone else resized it first.
+static int resize(struct hashtable *ht, int nbucket, int from) {
+  struct ht_table *nt, *old;
+
+  if ((nt = table_alloc(ht, nbucket)) == 0) return -1;
+
+  acquire(&ht->resize_lock);
+  old = ht->table;
+  if (from > 0 && old->nbucket != from) {
+    release(&ht->resize_lock);
+    kfree(nt);
+    return 0;
+  }
+  for (int i = 0; i < old->nbucket; i++) acquire(&old->b[i].lock);
+  for (int i = 0; i < old->nbucket; i++) {
+    struct ht_node *n, *next;
+    for (n = old->b[i].head; n; n = next) {
+      struct ht_bucket *b = bucket(nt, n->key);
+      next = n->next;
+      n->next = b->head;
+      b->head = n;
+    }
+  }
+  __atomic_store_n(&ht->table, nt, __ATOMIC_RELEASE);
+  for (int i = 0; i < old->nbucket; i++) release(&old->b[i].lock);
+  release(&ht->resize_lock);
+
+  epoch_retire(&old->node, table_free);
+  return 0;
+}
+
+int ht_resize(struct hashtable *ht, int nbucket) {
+  return resize(ht, nbucket, 0);
+}
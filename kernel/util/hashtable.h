@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../types.h"
+#include "spinlock.h"
+
+// Intrusive hash table keyed by uint64, with a lock per bucket. Objects
+// embed a struct ht_node; several may share a key. To look up, add or
+// delete, lock the key's bucket:
+//
+//   struct ht_bucket *b = ht_lock(ht, key);
+//   for (n = ht_find(b, key); n; n = ht_find_next(n, key))
+//     ...
+//   ht_unlock(ht, b);
+//
+// Hold one bucket at a time, and don't sleep while holding it. The
+// table doubles once it averages more than HT_LOAD nodes per bucket.
+// Bucket arrays it replaces are freed through the epoch machinery.
+
+#define HT_LOAD 2
+
+struct ht_node {
+  struct ht_node *next;
+  uint64 key;
+};
+
+// Get the object a node is embedded in
+#define ht_container(n, type, member) \
+  ((type *)((char *)(n) - __builtin_offsetof(type, member)))
+
+struct ht_bucket {
+  struct spinlock lock;
+  struct ht_node *head;
+};
+
+struct ht_table;
+
+struct hashtable {
+  struct ht_table *table;
+  struct spinlock resize_lock;  // Serializes resizes and ht_foreach()
+  int count;                    // Nodes in the table
+  char *name;                   // Name of the bucket locks
+};
+
+// Returns 0 on success, -1 if out of memory. nbucket is rounded up to a
+// power of two.
+int ht_init(struct hashtable *, char *name, int nbucket);
+// Free the buckets of an empty table.
+void ht_destroy(struct hashtable *);
+
+struct ht_bucket *ht_lock(struct hashtable *, uint64 key);
+void ht_unlock(struct hashtable *, struct ht_bucket *);
+// First and next node with the key in a locked bucket, or 0.
+struct ht_node *ht_find(struct ht_bucket *, uint64 key);
+struct ht_node *ht_find_next(struct ht_node *, uint64 key);
+// b must be the locked bucket of key, or of n's key for ht_del().
+void ht_add(struct hashtable *, struct ht_bucket *b, struct ht_node *n,
+            uint64 key);
+void ht_del(struct hashtable *, struct ht_bucket *b, struct ht_node *n);
+
+// Lock, add or delete, unlock.
+void ht_insert(struct hashtable *, struct ht_node *, uint64 key);
+void ht_remove(struct hashtable *, struct ht_node *);
+
+// Call fn on every node with its bucket locked, until it returns
+// non-zero; returns that value, or 0. fn must not change the table.
+int ht_foreach(struct hashtable *, int (*fn)(struct ht_node *, void *),
+               void *arg);
+
+// Rehash into nbucket buckets, rounded up to a power of two.
+// Returns 0 on success, -1 if out of memory.
+int ht_resize(struct hashtable *, int nbucket);
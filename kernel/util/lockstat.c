@@ -0,0 +1,129 @@
+// Lock contention statistics, see lockstat.h.
+//
+// acquire(), release() and acquiresleep() call in here with interrupts
+// off, so each hart updates its own open-addressed table without a
+// lock, keyed by the lock's name pointer and the acquire() call site.
+// Reading the LOCKSTAT device merges the tables. Sites that don't fit
+// in a full table aren't counted.
+
+#include "lockstat.h"
+
+#include "../fs/file.h"
+#include "../proc/proc.h"
+#include "string.h"
+
+#ifdef LOCK_STATS
+
+#define NLOCKSTAT 128
+
+struct entry {
+  char *name;
+  uint64 site;
+  uint64 acquisitions;
+  uint64 contended;
+  uint64 spin_cycles;
+  uint64 max_hold;
+  uint64 sleeps;
+};
+
+static struct {
+  struct entry e[NLOCKSTAT];
+} __attribute__((aligned(64))) tables[NCPU];
+
+// Find the entry for name and site in table t, claiming a free one if
+// create is set. Returns 0 if there's none.
+static struct entry *lookup(int t, char *name, uint64 site, int create) {
+  uint64 h = ((uint64)name ^ site) * 0x9e3779b97f4a7c15UL;
+  uint idx = h >> 57;  // 7 bits for 128 entries
+
+  for (int i = 0; i < NLOCKSTAT; i++) {
+    struct entry *e = &tables[t].e[(idx + i) % NLOCKSTAT];
+    if (e->name == name && e->site == site) return e;
+    if (e->name == 0) {
+      if (!create) return 0;
+      e->site = site;
+      e->name = name;
+      return e;
+    }
+  }
+  return 0;
+}
+
+void lockstat_acquired(struct spinlock *lk, int contended, uint64 spin) {
+  lockstat_count(lk->name, lk->site, contended, 0, spin);
+}
+
+void lockstat_released(struct spinlock *lk, uint64 hold) {
+  struct entry *e = lookup(cpuid(), lk->name, lk->site, 0);
+  if (e && hold > e->max_hold) e->max_hold = hold;
+}
+
+// Count an acquisition at site; spin is the time spent spinning for it.
+void lockstat_count(char *name, uint64 site, int contended, int slept,
+                    uint64 spin) {
+  struct entry *e = lookup(cpuid(), name, site, 1);
+  if (e == 0) return;
+  e->acquisitions++;
+  if (contended) {
+    e->contended++;
+    e->spin_cycles += spin;
+  }
+  if (slept) e->sleeps++;
+}
+
+// Copy a snapshot of the merged tables to dst, as many whole entries as
+// fit in n bytes. Each site is reported by the first hart that has it.
+static int lockstatread(int user_dst, uint64 dst, int n) {
+  struct lockstat st;
+  int got = 0;
+
+  for (int c = 0; c < NCPU; c++) {
+    for (int i = 0; i < NLOCKSTAT; i++) {
+      struct entry *e = &tables[c].e[i];
+      if (e->name == 0) continue;
+
+      int seen = 0;
+      for (int d = 0; d < c && !seen; d++)
+        seen = lookup(d, e->name, e->site, 0) != 0;
+      if (seen) continue;
+      if (got + sizeof(st) > n) return got;
+
+      memset(&st, 0, sizeof(st));
+      safestrcpy(st.name, e->name, sizeof(st.name));
+      st.site = e->site;
+      for (int d = c; d < NCPU; d++) {
+        struct entry *f = lookup(d, e->name, e->site, 0);
+        if (f == 0) continue;
+        st.acquisitions += f->acquisitions;
+        st.contended += f->contended;
+        st.spin_cycles += f->spin_cycles;
+        if (f->max_hold > st.max_hold) st.max_hold = f->max_hold;
+        st.sleeps += f->sleeps;
+      }
+      if (either_copyout(user_dst, dst + got, &st, sizeof(st)) < 0)
+        return -1;
+      got += sizeof(st);
+    }
+  }
+  return got;
+}
+
+// Any write resets the tables. A hart updating its table meanwhile may
+// keep part of its old counts.
+static int lockstatwrite(int user_src, uint64 src, int n) {
+  for (int c = 0; c < NCPU; c++) memset(tables[c].e, 0, sizeof(tables[c].e));
+  return n;
+}
+
+void lockstatinit(void) {
+  devsw[LOCKSTAT].read = lockstatread;
+  devsw[LOCKSTAT].write = lockstatwrite;
+}
+
+#else
+
+// Nothing is collected; the device stays unregistered, so opening it
+// works but reads fail.
+void lockstatinit(void) {}
+
+#endif
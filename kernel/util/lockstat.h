@@ -0,0 +1,19 @@
+#pragma once
+
+#include "../types.h"
+
+// Spinlock and sleeplock contention statistics, only collected in
+// kernels built with LOCKSTAT=1. Reading the LOCKSTAT device returns an
+// array of struct lockstat, one per lock name and acquire() or
+// acquiresleep() call site; writing anything to it resets them.
+
+struct lockstat {
+  char name[16];        // Lock name, truncated
+  uint64 site;          // Return address of acquire()
+  uint64 acquisitions;
+  uint64 contended;     // Acquisitions that found the lock held
+  uint64 spin_cycles;   // Total cycles spent spinning for the lock
+  uint64 max_hold;      // Longest time held, in cycles; spinlocks only
+  uint64 sleeps;        // Contended acquisitions that had to sleep;
+                        // the others spun. Sleeplocks only.
+};
@@ -0,0 +1,39 @@
+// Per-hart counters, see percpu.h.
+//
+// Only the owning hart writes a slot, with interrupts off, so adding
+// needs no lock and no atomic read-modify-write until a fold. Readers
+// load the slots while harts keep adding; a sum taken meanwhile may
+// miss a delta that's being folded.
+
+#include "percpu.h"
+
+#include "spinlock.h"
+
+void percpu_counter_init(struct percpu_counter *c, long val, long batch) {
+  c->count = val;
+  c->batch = batch;
+  for (int i = 0; i < NCPU; i++) per_cpu(c->cpu, i) = 0;
+}
+
+void percpu_counter_add(struct percpu_counter *c, long n) {
+  push_off();
+  long *d = &this_cpu(c->cpu);
+  long v = *d + n;
+  if (v >= c->batch || v <= -c->batch) {
+    __atomic_fetch_add(&c->count, v, __ATOMIC_RELAXED);
+    v = 0;
+  }
+  __atomic_store_n(d, v, __ATOMIC_RELAXED);
+  pop_off();
+}
+
+long percpu_counter_read(struct percpu_counter *c) {
+  return __atomic_load_n(&c->count, __ATOMIC_RELAXED);
+}
+
+long percpu_counter_sum(struct percpu_counter *c) {
+  long sum = __atomic_load_n(&c->count, __ATOMIC_RELAXED);
+  for (int i = 0; i < NCPU; i++)
+    sum += __atomic_load_n(&per_cpu(c->cpu, i), __ATOMIC_RELAXED);
+  return sum;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../param.h"
+#include "../types.h"
+
+// Per-hart data. PERCPU(type) wraps type in a struct aligned to a cache
+// line, so each hart's copy in an array of NCPU has a line to itself
+// and updating it doesn't bounce the line between harts:
+//   static PERCPU(struct foo) foo[NCPU];
+//   this_cpu(foo).bar++;  // with interrupts off
+#define CACHELINE 64
+#define PERCPU(type) \
+  struct {           \
+    type v;          \
+  } __attribute__((aligned(CACHELINE)))
+#define per_cpu(var, c) ((var)[c].v)
+#define this_cpu(var) per_cpu(var, cpuid())
+
+int cpuid(void);
+
+// A counter each hart adds to in its own slot. A slot is folded into
+// count once it reaches batch either way, so percpu_counter_read() is
+// within NCPU * batch of the total and costs one load, while
+// percpu_counter_sum() adds up every slot. A zeroed counter is valid
+// and folds on every add.
+struct percpu_counter {
+  long count;
+  long batch;
+  PERCPU(long) cpu[NCPU];
+};
+
+// For counters that are only ever summed: never fold.
+#define PERCPU_NOFOLD (1L << 62)
+
+void percpu_counter_init(struct percpu_counter *, long val, long batch);
+void percpu_counter_add(struct percpu_counter *, long n);
+long percpu_counter_read(struct percpu_counter *);
+long percpu_counter_sum(struct percpu_counter *);
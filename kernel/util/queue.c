@@ -0,0 +1,115 @@
+// Lock-free ring buffers, see queue.h.
+//
+// A side publishes with a release store of its index (or of a slot's
+// sequence number) after touching the element, and the other side
+// reads it with an acquire load before touching the element. On RISC-V
+// these compile to "fence rw,w" before the store and "fence r,rw"
+// after the load, which is all the ordering a handoff needs.
+
+#include "queue.h"
+
+#include "../printf.h"
+#include "string.h"
+
+static char *slot(char *buf, uint esize, uint mask, uint i) {
+  return buf + (i & mask) * esize;
+}
+
+void spsc_init(struct spsc *q, void *buf, uint esize, uint n) {
+  if (n == 0 || (n & (n - 1)) != 0) panic("spsc_init");
+  q->mask = n - 1;
+  q->esize = esize;
+  q->buf = buf;
+  q->head = 0;
+  q->tail = 0;
+}
+
+// Returns 0, or -1 if q is full.
+int spsc_push(struct spsc *q, const void *e) {
+  uint h = q->head;
+  if (h - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) > q->mask) return -1;
+  memmove(slot(q->buf, q->esize, q->mask, h), e, q->esize);
+  __atomic_store_n(&q->head, h + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+// Copy the oldest element to e without removing it. Returns 0, or -1
+// if q is empty.
+int spsc_peek(struct spsc *q, void *e) {
+  uint t = q->tail;
+  if (__atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == t) return -1;
+  memmove(e, slot(q->buf, q->esize, q->mask, t), q->esize);
+  return 0;
+}
+
+// Returns 0, or -1 if q is empty.
+int spsc_pop(struct spsc *q, void *e) {
+  if (spsc_peek(q, e) < 0) return -1;
+  __atomic_store_n(&q->tail, q->tail + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+// Exact only to the side calling it; the other may be moving.
+uint spsc_count(struct spsc *q) {
+  return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) -
+         __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+}
+
+void mpsc_init(struct mpsc *q, void *buf, uint *seq, uint esize, uint n) {
+  if (n == 0 || (n & (n - 1)) != 0) panic("mpsc_init");
+  q->mask = n - 1;
+  q->esize = esize;
+  q->buf = buf;
+  q->seq = seq;
+  for (uint i = 0; i < n; i++) seq[i] = i;
+  q->head = 0;
+  q->tail = 0;
+}
+
+// Claim a slot by moving head past it, fill it, then hand it over by
+// bumping its sequence number. Returns 0, or -1 if q is full.
+int mpsc_push(struct mpsc *q, const void *e) {
+  uint h = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+  for (;;) {
+    uint s = __atomic_load_n(&q->seq[h & q->mask], __ATOMIC_ACQUIRE);
+    int diff = (int)(s - h);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&q->head, &h, h + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0) {
+      return -1;  // The slot still holds element h - n.
+    } else {
+      h = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    }
+  }
+  memmove(slot(q->buf, q->esize, q->mask, h), e, q->esize);
+  __atomic_store_n(&q->seq[h & q->mask], h + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+// Returns 0, or -1 if q is empty or its oldest element is still being
+// filled in. In that case its producer has to get a consumer to run
+// again once it's done.
+int mpsc_pop(struct mpsc *q, void *e) {
+  uint t = q->tail;
+  uint *s = &q->seq[t & q->mask];
+  if (__atomic_load_n(s, __ATOMIC_ACQUIRE) != t + 1) return -1;
+  memmove(e, slot(q->buf, q->esize, q->mask, t), q->esize);
+  __atomic_store_n(s, t + q->mask + 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&q->tail, t + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+// Would mpsc_pop() find an element now? Anyone may ask, not only the
+// consumer.
+int mpsc_ready(struct mpsc *q) {
+  uint t = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+  return __atomic_load_n(&q->seq[t & q->mask], __ATOMIC_ACQUIRE) == t + 1;
+}
+
+// Elements claimed and not yet popped, some perhaps still being filled.
+uint mpsc_count(struct mpsc *q) {
+  return __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) -
+         __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../types.h"
+#include "percpu.h"
+
+// Lock-free ring buffers of n fixed-size elements, n a power of two,
+// kept in storage the caller provides, so they work before kinit().
+// Pushing fails when the ring is full and popping when it's empty;
+// neither ever waits for the other side.
+//
+// struct spsc allows one producer and one consumer at a time. struct
+// mpsc allows any number of concurrent producers, but still one
+// consumer; callers serialize consumers themselves. For example:
+//
+//   static char buf[64];
+//   static uint seq[64];
+//   mpsc_init(&q, buf, seq, 1, 64);
+//
+// The fields each side writes sit on cache lines of their own.
+
+struct spsc {
+  uint mask;
+  uint esize;
+  char *buf;
+  uint head __attribute__((aligned(CACHELINE)));  // Next slot to fill
+  uint tail __attribute__((aligned(CACHELINE)));  // Next slot to drain
+};
+
+void spsc_init(struct spsc *, void *buf, uint esize, uint n);
+int spsc_push(struct spsc *, const void *e);
+int spsc_pop(struct spsc *, void *e);
+int spsc_peek(struct spsc *, void *e);
+uint spsc_count(struct spsc *);
+
+// Each slot has a sequence number saying whose turn it is: i while
+// empty for the producer of element i, i + 1 once that element is in.
+struct mpsc {
+  uint mask;
+  uint esize;
+  char *buf;
+  uint *seq;
+  uint head __attribute__((aligned(CACHELINE)));  // Next slot to claim
+  uint tail __attribute__((aligned(CACHELINE)));  // Next slot to drain
+};
+
+void mpsc_init(struct mpsc *, void *buf, uint *seq, uint esize, uint n);
+int mpsc_push(struct mpsc *, const void *e);
+int mpsc_pop(struct mpsc *, void *e);
+int mpsc_ready(struct mpsc *);
+uint mpsc_count(struct mpsc *);
@@ -0,0 +1,67 @@
+// Sleeping reader/writer locks, see rwsem.h.
+//
+// Each acquirer takes a ticket and sleeps until it is served. The
+// served reader lets the next ticket in at once; the served writer
+// does too, but the next in line still waits for it to leave. A writer
+// gets in when the readers that went before it have all left.
+
+#include "rwsem.h"
+
+#include "../printf.h"
+#include "../proc/proc.h"
+
+void initrwsem(struct rwsem *rw, char *name) {
+  initlock(&rw->lk, "rwsem");
+  rw->name = name;
+  rw->next = 0;
+  rw->serving = 0;
+  rw->readers = 0;
+  rw->writer = 0;
+  rw->pid = 0;
+}
+
+void rwsem_acquire_read(struct rwsem *rw) {
+  acquire(&rw->lk);
+  uint t = rw->next++;
+  while (t != rw->serving || rw->writer) sleep(rw, &rw->lk);
+  rw->readers++;
+  rw->serving++;
+  wakeup(rw);  // the next ticket may be a reader too
+  release(&rw->lk);
+}
+
+void rwsem_release_read(struct rwsem *rw) {
+  acquire(&rw->lk);
+  if (rw->readers < 1) panic("rwsem_release_read");
+  if (--rw->readers == 0) wakeup(rw);
+  release(&rw->lk);
+}
+
+void rwsem_acquire_write(struct rwsem *rw) {
+  acquire(&rw->lk);
+  uint t = rw->next++;
+  while (t != rw->serving || rw->writer || rw->readers)
+    sleep(rw, &rw->lk);
+  rw->writer = 1;
+  rw->pid = myproc()->pid;
+  rw->serving++;
+  release(&rw->lk);
+}
+
+void rwsem_release_write(struct rwsem *rw) {
+  acquire(&rw->lk);
+  if (!rw->writer) panic("rwsem_release_write");
+  rw->writer = 0;
+  rw->pid = 0;
+  wakeup(rw);
+  release(&rw->lk);
+}
+
+int rwsem_holding_write(struct rwsem *rw) {
+  int r;
+
+  acquire(&rw->lk);
+  r = rw->writer && (rw->pid == myproc()->pid);
+  release(&rw->lk);
+  return r;
+}
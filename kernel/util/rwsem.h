@@ -0,0 +1,25 @@
+#pragma once
+
+#include "spinlock.h"
+
+// Long-term reader/writer lock for processes. Holders may sleep.
+// Arrivals are served in FIFO order, so a waiting writer holds off
+// readers that come after it; consecutive readers share the lock.
+struct rwsem {
+  struct spinlock lk;  // spinlock protecting this rwsem
+  uint next;           // Next ticket to hand out
+  uint serving;        // Ticket of the first waiter allowed in
+  int readers;         // Number of readers holding it
+  int writer;          // Is a writer holding it?
+
+  // For debugging:
+  char *name;  // Name of lock.
+  int pid;     // Process holding it for writing
+};
+
+void initrwsem(struct rwsem *, char *);
+void rwsem_acquire_read(struct rwsem *);
+void rwsem_release_read(struct rwsem *);
+void rwsem_acquire_write(struct rwsem *);
+void rwsem_release_write(struct rwsem *);
+int rwsem_holding_write(struct rwsem *);
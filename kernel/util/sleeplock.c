@@ -2,23 +2,86 @@
 
 #include "sleeplock.h"
 
+#include "../mem/memlayout.h"
 #include "../proc/proc.h"
+#include "epoch.h"
 #include "spinlock.h"
 
+// Longest an adaptive acquiresleep() spins before sleeping, in time
+// CSR cycles (50us).
+#define SPIN_MAX (CLINT_FREQ / 20000)
+
 void initsleeplock(struct sleeplock *lk, char *name) {
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
   lk->locked = 0;
+  lk->adaptive = 0;
   lk->pid = 0;
+  lk->cpu = -1;
+  lk->owner = 0;
+}
+
+// A lock whose waiters spin instead of sleeping while the holder is
+// running on another hart, for locks held briefly.
+void initsleeplock_adaptive(struct sleeplock *lk, char *name) {
+  initsleeplock(lk, name);
+  lk->adaptive = 1;
+}
+
+// Called with lk->lk held while lk is locked. If the holder is running,
+// drop lk->lk and spin until the lock is released, the holder stops
+// running or the deadline passes, then take lk->lk again and return 1.
+// Otherwise return 0 without dropping lk->lk.
+static int spin_on_owner(struct sleeplock *lk, uint64 deadline) {
+  struct proc *o;
+
+  if (!lk->adaptive || r_time() >= deadline) return 0;
+
+  // The epoch keeps the holder's struct proc allocated while we look at
+  // it, even if it releases the lock and exits meanwhile.
+  epoch_enter();
+  o = lk->owner;
+  if (o == 0 || __atomic_load_n(&o->state, __ATOMIC_RELAXED) != RUNNING) {
+    epoch_exit();
+    return 0;
+  }
+  release(&lk->lk);
+  while (__atomic_load_n(&lk->locked, __ATOMIC_RELAXED) &&
+         __atomic_load_n(&lk->owner, __ATOMIC_RELAXED) == o &&
+         __atomic_load_n(&o->state, __ATOMIC_RELAXED) == RUNNING &&
+         r_time() < deadline)
+    ;
+  epoch_exit();
+  acquire(&lk->lk);
+  return 1;
 }
 
 void acquiresleep(struct sleeplock *lk) {
+  uint64 deadline = r_time() + SPIN_MAX;
+#ifdef LOCK_STATS
+  uint64 site = (uint64)__builtin_return_address(0), t0 = r_cycle();
+  int contended = 0, slept = 0;
+#endif
+
   acquire(&lk->lk);
   while (lk->locked) {
+#ifdef LOCK_STATS
+    contended = 1;
+#endif
+    if (spin_on_owner(lk, deadline)) continue;
+#ifdef LOCK_STATS
+    slept = 1;
+#endif
     sleep(lk, &lk->lk);
   }
   lk->locked = 1;
   lk->pid = myproc()->pid;
+  lk->cpu = cpuid();
+  lk->owner = myproc();
+#ifdef LOCK_STATS
+  lockstat_count(lk->name, site, contended, slept,
+                 slept ? 0 : r_cycle() - t0);
+#endif
   release(&lk->lk);
 }
 
@@ -26,6 +89,8 @@ void releasesleep(struct sleeplock *lk) {
   acquire(&lk->lk);
   lk->locked = 0;
   lk->pid = 0;
+  lk->cpu = -1;
+  lk->owner = 0;
   wakeup(lk);
   release(&lk->lk);
 }
@@ -2,17 +2,23 @@
 
 #include "spinlock.h"
 
+struct proc;
+
 // Long-term locks for processes
 struct sleeplock {
   uint locked;         // Is the lock held?
   struct spinlock lk;  // spinlock protecting this sleep lock
+  int adaptive;        // Spin while the holder runs? See sleeplock.c
 
   // For debugging:
-  char *name;  // Name of lock.
-  int pid;     // Process holding lock
+  char *name;          // Name of lock.
+  int pid;             // Process holding lock
+  int cpu;             // Hart it was acquired on
+  struct proc *owner;  // Process holding lock, for adaptive spinning
 };
 
 void acquiresleep(struct sleeplock *);
 void releasesleep(struct sleeplock *);
 int holdingsleep(struct sleeplock *);
 void initsleeplock(struct sleeplock *, char *);
+void initsleeplock_adaptive(struct sleeplock *, char *);
@@ -6,9 +6,112 @@
 #include "../proc/proc.h"
 
 void initlock(struct spinlock *lk, char *name) {
+  initlock_type(lk, name, SPIN_TAS);
+}
+
+void initlock_type(struct spinlock *lk, char *name, enum spintype type) {
   lk->name = name;
   lk->locked = 0;
   lk->cpu = 0;
+  lk->type = type;
+  lk->next = 0;
+  lk->owner = 0;
+  lk->tail = 0;
+  lk->node = 0;
+}
+
+// The *_lock() functions each return whether they had to wait.
+
+static int tas_lock(struct spinlock *lk) {
+  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
+  //   a5 = 1
+  //   s1 = &lk->locked
+  //   amoswap.w.aq a5, a5, (s1)
+  if (__sync_lock_test_and_set(&lk->locked, 1) == 0) return 0;
+  while (__sync_lock_test_and_set(&lk->locked, 1) != 0)
+    ;
+  return 1;
+}
+
+static void tas_unlock(struct spinlock *lk) {
+  // Release the lock, equivalent to lk->locked = 0.
+  // This code doesn't use a C assignment, since the C standard
+  // implies that an assignment might be implemented with
+  // multiple store instructions.
+  // On RISC-V, sync_lock_release turns into an atomic swap:
+  //   s1 = &lk->locked
+  //   amoswap.w zero, zero, (s1)
+  __sync_lock_release(&lk->locked);
+}
+
+// Take a ticket and wait for it to be served.
+static int ticket_lock(struct spinlock *lk) {
+  uint t = __sync_fetch_and_add(&lk->next, 1);
+
+  if (__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) == t) return 0;
+  while (__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) != t)
+    ;
+  return 1;
+}
+
+static void ticket_unlock(struct spinlock *lk) {
+  __atomic_store_n(&lk->owner, lk->owner + 1, __ATOMIC_RELEASE);
+}
+
+// Queue one of this hart's nodes at the tail and spin on it until the
+// previous holder hands the lock over.
+static int mcs_lock(struct spinlock *lk) {
+  struct cpu *c = mycpu();
+  struct mcs_node *n, *prev;
+  int i;
+
+  for (i = 0; i < NMCS && (c->mcs_used & (1 << i)); i++)
+    ;
+  if (i == NMCS) panic("acquire: too many MCS locks");
+  c->mcs_used |= 1 << i;
+  n = &c->mcs[i];
+  n->next = 0;
+  n->locked = 1;
+
+  prev = __atomic_exchange_n(&lk->tail, n, __ATOMIC_ACQ_REL);
+  if (prev) {
+    __atomic_store_n(&prev->next, n, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&n->locked, __ATOMIC_ACQUIRE))
+      ;
+  }
+  lk->node = n;
+  return prev != 0;
+}
+
+// Hand the lock to the next node in the queue, or empty the queue.
+static void mcs_unlock(struct spinlock *lk) {
+  struct cpu *c = mycpu();
+  struct mcs_node *n = lk->node, *next, *expect = n;
+
+  next = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE);
+  if (next == 0) {
+    if (__atomic_compare_exchange_n(&lk->tail, &expect, 0, 0,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+      goto done;
+    // A waiter swapped itself in but hasn't linked to us yet.
+    while ((next = __atomic_load_n(&n->next, __ATOMIC_ACQUIRE)) == 0)
+      ;
+  }
+  __atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+done:
+  c->mcs_used &= ~(1 << (n - c->mcs));
+}
+
+// Wait for the lock, returning whether it was held by someone else.
+static int lock(struct spinlock *lk) {
+  switch (lk->type) {
+    case SPIN_TICKET:
+      return ticket_lock(lk);
+    case SPIN_MCS:
+      return mcs_lock(lk);
+    default:
+      return tas_lock(lk);
+  }
 }
 
 // Acquire the lock.
@@ -20,12 +123,12 @@ void acquire(struct spinlock *lk) {
     panic("acquire");
   }
 
-  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
-  //   a5 = 1
-  //   s1 = &lk->locked
-  //   amoswap.w.aq a5, a5, (s1)
-  while (__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+#ifdef LOCK_STATS
+  uint64 t0 = r_cycle();
+  int contended = lock(lk);
+#else
+  lock(lk);
+#endif
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -34,13 +137,25 @@ void acquire(struct spinlock *lk) {
   __sync_synchronize();
 
   // Record info about lock acquisition for holding() and debugging.
+  // The queued locks keep locked only for holding().
+  lk->locked = 1;
   lk->cpu = mycpu();
+
+#ifdef LOCK_STATS
+  lk->acquired = r_cycle();
+  lk->site = (uint64)__builtin_return_address(0);
+  lockstat_acquired(lk, contended, lk->acquired - t0);
+#endif
 }
 
 // Release the lock.
 void release(struct spinlock *lk) {
   if (!holding(lk)) panic("release");
 
+#ifdef LOCK_STATS
+  lockstat_released(lk, r_cycle() - lk->acquired);
+#endif
+
   lk->cpu = 0;
 
   // Tell the C compiler and the CPU to not move loads or stores
@@ -51,14 +166,18 @@ void release(struct spinlock *lk) {
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code doesn't use a C assignment, since the C standard
-  // implies that an assignment might be implemented with
-  // multiple store instructions.
-  // On RISC-V, sync_lock_release turns into an atomic swap:
-  //   s1 = &lk->locked
-  //   amoswap.w zero, zero, (s1)
-  __sync_lock_release(&lk->locked);
+  switch (lk->type) {
+    case SPIN_TICKET:
+      lk->locked = 0;
+      ticket_unlock(lk);
+      break;
+    case SPIN_MCS:
+      lk->locked = 0;
+      mcs_unlock(lk);
+      break;
+    default:
+      tas_unlock(lk);
+  }
 
   pop_off();
 }
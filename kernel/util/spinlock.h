@@ -4,18 +4,56 @@
 
 struct cpu;
 
-// Mutual exclusion lock.
+// How a spinlock makes waiters take turns, chosen per lock with
+// initlock_type().
+enum spintype {
+  SPIN_TAS,     // Everyone swaps on one word; cheap but unfair.
+  SPIN_TICKET,  // FIFO by ticket number; waiters poll one shared word.
+  SPIN_MCS,     // FIFO queue; each waiter spins on its own mcs_node.
+};
+
+// An MCS waiter's place in the queue, one per lock a hart holds or
+// waits for. See cpu.mcs in proc.h.
+struct mcs_node {
+  struct mcs_node *next;
+  int locked;
+} __attribute__((aligned(64)));
+
+// Number of MCS locks a hart can hold at once.
+#define NMCS 8
+
+// Mutual exclusion lock. All zeroes is an unheld SPIN_TAS lock.
 struct spinlock {
-  uint locked;  // Is the lock held?
+  uint locked;  // Is the lock held? The lock word for SPIN_TAS.
+  enum spintype type;
+  uint next;              // SPIN_TICKET: next ticket to hand out
+  uint owner;             // SPIN_TICKET: ticket now being served
+  struct mcs_node *tail;  // SPIN_MCS: last waiter in the queue
+  struct mcs_node *node;  // SPIN_MCS: the holder's node
 
   // For debugging:
   char *name;       // Name of lock.
   struct cpu *cpu;  // The cpu holding the lock.
+
+#ifdef LOCK_STATS
+  uint64 site;      // Return address of the holder's acquire().
+  uint64 acquired;  // Cycle counter when it was acquired.
+#endif
 };
 
 void acquire(struct spinlock *);
 int holding(struct spinlock *);
 void initlock(struct spinlock *, char *);
+void initlock_type(struct spinlock *, char *, enum spintype);
 void release(struct spinlock *);
 void push_off(void);
 void pop_off(void);
+
+// lockstat.c
+void lockstatinit(void);
+#ifdef LOCK_STATS
+void lockstat_acquired(struct spinlock *, int contended, uint64 spin);
+void lockstat_released(struct spinlock *, uint64 hold);
+void lockstat_count(char *name, uint64 site, int contended, int slept,
+                    uint64 spin);
+#endif
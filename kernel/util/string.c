@@ -1,11 +1,34 @@
 #include "string.h"
 
+// The mem* functions move 8-byte words once dst (and src) are aligned,
+// four at a time, and bytes for the unaligned head and tail. When dst
+// and src are aligned differently they fall back to bytes, since
+// misaligned word accesses may trap to slow emulation.
+
+// A word that may alias anything, so that word-wide accesses to char
+// buffers stay correct under strict aliasing.
+typedef uint64 __attribute__((may_alias)) word;
+
+#define WORD sizeof(word)
+#define ALIGNED(p) (((uint64)(p) & (WORD - 1)) == 0)
+
 void *memset(void *dst, int c, uint n) {
-  char *cdst = (char *)dst;
-  int i;
-  for (i = 0; i < n; i++) {
-    cdst[i] = c;
+  uchar *d = dst;
+  word w = (uchar)c;
+
+  w |= w << 8;
+  w |= w << 16;
+  w |= w << 32;
+
+  for (; n > 0 && !ALIGNED(d); n--) *d++ = c;
+  for (; n >= 4 * WORD; n -= 4 * WORD, d += 4 * WORD) {
+    ((word *)d)[0] = w;
+    ((word *)d)[1] = w;
+    ((word *)d)[2] = w;
+    ((word *)d)[3] = w;
   }
+  for (; n >= WORD; n -= WORD, d += WORD) *(word *)d = w;
+  for (; n > 0; n--) *d++ = c;
   return dst;
 }
 
@@ -22,27 +45,68 @@ int memcmp(const void *v1, const void *v2, uint n) {
   return 0;
 }
 
-void *memmove(void *dst, const void *src, uint n) {
-  const char *s;
-  char *d;
-
-  if (n == 0) return dst;
+// Copy n bytes from s to d, lowest address first.
+static void copy_forward(uchar *d, const uchar *s, uint n) {
+  if (((uint64)d ^ (uint64)s) & (WORD - 1)) {
+    while (n-- > 0) *d++ = *s++;
+    return;
+  }
+  for (; n > 0 && !ALIGNED(d); n--) *d++ = *s++;
+  for (; n >= 4 * WORD; n -= 4 * WORD, d += 4 * WORD, s += 4 * WORD) {
+    word w0 = ((word *)s)[0], w1 = ((word *)s)[1];
+    word w2 = ((word *)s)[2], w3 = ((word *)s)[3];
+    ((word *)d)[0] = w0;
+    ((word *)d)[1] = w1;
+    ((word *)d)[2] = w2;
+    ((word *)d)[3] = w3;
+  }
+  for (; n >= WORD; n -= WORD, d += WORD, s += WORD)
+    *(word *)d = *(word *)s;
+  while (n-- > 0) *d++ = *s++;
+}
 
-  s = src;
-  d = dst;
-  if (s < d && s + n > d) {
-    s += n;
-    d += n;
+// Copy the n bytes below d + n from below s + n, highest address first.
+static void copy_backward(uchar *d, const uchar *s, uint n) {
+  d += n;
+  s += n;
+  if (((uint64)d ^ (uint64)s) & (WORD - 1)) {
     while (n-- > 0) *--d = *--s;
-  } else
-    while (n-- > 0) *d++ = *s++;
+    return;
+  }
+  for (; n > 0 && !ALIGNED(d); n--) *--d = *--s;
+  for (; n >= 4 * WORD; n -= 4 * WORD) {
+    d -= 4 * WORD;
+    s -= 4 * WORD;
+    word w3 = ((word *)s)[3], w2 = ((word *)s)[2];
+    word w1 = ((word *)s)[1], w0 = ((word *)s)[0];
+    ((word *)d)[3] = w3;
+    ((word *)d)[2] = w2;
+    ((word *)d)[1] = w1;
+    ((word *)d)[0] = w0;
+  }
+  for (; n >= WORD; n -= WORD) {
+    d -= WORD;
+    s -= WORD;
+    *(word *)d = *(word *)s;
+  }
+  while (n-- > 0) *--d = *--s;
+}
+
+void *memmove(void *dst, const void *src, uint n) {
+  const uchar *s = src;
+  uchar *d = dst;
 
+  if (s < d && s + n > d)
+    copy_backward(d, s, n);
+  else
+    copy_forward(d, s, n);
   return dst;
 }
 
-// memcpy exists to placate GCC.  Use memmove.
+// Like memmove, but dst and src must not overlap.
 void *memcpy(void *dst, const void *src, uint n) {
-  return memmove(dst, src, n);
+  copy_forward(dst, src, n);
+  return dst;
 }
 
 int strncmp(const char *p, const char *q, uint n) {
@@ -5,6 +5,7 @@
 #define NELEM(x) (sizeof(x) / sizeof((x)[0]))
 
 int memcmp(const void*, const void*, uint);
+void* memcpy(void*, const void*, uint);
 void* memmove(void*, const void*, uint);
 void* memset(void*, int, uint);
 char* safestrcpy(char*, const char*, int);
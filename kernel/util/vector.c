@@ -2,19 +2,69 @@
 
 #include "../mem/kalloc.h"
 #include "../printf.h"
+#include "epoch.h"
 #include "string.h"
 
+// Element storage. Readers may still be using the old storage after a
+// v_grow(), so it's freed through the epoch machinery.
+struct v_storage {
+  struct epoch_node node;
+  int capacity;
+  uint64 data[];
+};
+
+static void v_free_storage(struct epoch_node *n) {
+  kfree(epoch_container(n, struct v_storage, node));
+}
+
+static void v_retire_data(uint64 *data) {
+  if (data == 0) return;
+  struct v_storage *st = epoch_container(data, struct v_storage, data);
+  epoch_retire(&st->node, v_free_storage);
+}
+
+// Words of freemap and freesum for a given capacity.
+static int map_words(int capacity) { return (capacity + 63) / 64; }
+
+static int sum_words(int capacity) {
+  return (map_words(capacity) + 63) / 64;
+}
+
+static void mark_free(struct vector *v, int i) {
+  int w = i / 64;
+  v->freemap[w] |= 1UL << (i % 64);
+  v->freesum[w / 64] |= 1UL << (w % 64);
+}
+
+static void mark_used(struct vector *v, int i) {
+  int w = i / 64;
+  v->freemap[w] &= ~(1UL << (i % 64));
+  if (v->freemap[w] == 0) v->freesum[w / 64] &= ~(1UL << (w % 64));
+}
+
 void v_init(struct vector *v) {
   v->size = 0;
   v->capacity = 0;
   v->data = 0;
+  v->freemap = 0;
+  v->freesum = 0;
 }
 
 int v_grow(struct vector *v, int new_capacity) {
-  uint64 *new_data = malloc(sizeof(uint64) * new_capacity);
-  if (new_data == 0) {
+  struct v_storage *st =
+      malloc(sizeof(struct v_storage) + sizeof(uint64) * new_capacity);
+  if (st == 0) {
+    return -1;
+  }
+  int nmap = map_words(new_capacity);
+  int nwords = nmap + sum_words(new_capacity);
+  uint64 *map = malloc(sizeof(uint64) * nwords);
+  if (map == 0) {
+    kfree(st);
     return -1;
   }
+  st->capacity = new_capacity;
+  uint64 *new_data = st->data;
 
   uint64 cpy_mem = v->size;
   if (cpy_mem > new_capacity) {
@@ -23,47 +73,89 @@ int v_grow(struct vector *v, int new_capacity) {
 
   memset(new_data, 0, new_capacity * sizeof(uint64));  // empty space is 0
   memmove(new_data, v->data, cpy_mem * sizeof(uint64));
-  if (v->data != 0) {
-    kfree(v->data);
-  }
-  v->data = new_data;
+  uint64 *old_data = v->data;
+  // Publish the copy before anyone can see a size that needs it.
+  __atomic_store_n(&v->data, new_data, __ATOMIC_RELEASE);
   v->capacity = new_capacity;
+  v_retire_data(old_data);
+
+  // Nobody but writers reads the map, so the old one can go right away.
+  if (v->freemap) kfree(v->freemap);
+  memset(map, 0, nwords * sizeof(uint64));
+  v->freemap = map;
+  v->freesum = map + nmap;
+  for (int i = 0; i < cpy_mem; i++) {
+    if (new_data[i] == 0) mark_free(v, i);
+  }
   return 0;
 }
 
+// Safe against concurrent writers when called inside an epoch section:
+// size is loaded before data, and writers publish them in the reverse
+// order when growing. The storage's own capacity is checked as well,
+// since v_compact() can shrink it under a reader holding an old size.
 uint64 v_get(struct vector *v, int i) {
-  if (v->size <= i) panic("vector out of bounds get");
-  return v->data[i];
+  if (__atomic_load_n(&v->size, __ATOMIC_ACQUIRE) <= i) return 0;
+  uint64 *data = __atomic_load_n(&v->data, __ATOMIC_ACQUIRE);
+  if (data == 0) return 0;
+  if (epoch_container(data, struct v_storage, data)->capacity <= i) return 0;
+  return __atomic_load_n(&data[i], __ATOMIC_ACQUIRE);
 }
 
 void v_set(struct vector *v, int i, uint64 val) {
   if (v->size <= i) panic("vector out of bounds set");
-  v->data[i] = val;
+  if (val == 0)
+    mark_free(v, i);
+  else
+    mark_used(v, i);
+  __atomic_store_n(&v->data[i], val, __ATOMIC_RELEASE);
 }
 
 int v_push_back(struct vector *v, uint64 val) {
   if (v->size == v->capacity) {
     if (v_grow(v, (v->capacity == 0) ? 4 : v->capacity * 2) != 0) return -1;
   }
-  __sync_fetch_and_add(&v->size, 1);
-  v_set(v, v->size - 1, val);
+  // Fill the slot first, so readers never see it uninitialized.
+  __atomic_store_n(&v->data[v->size], val, __ATOMIC_RELEASE);
+  if (val == 0) mark_free(v, v->size);
+  __atomic_store_n(&v->size, v->size + 1, __ATOMIC_RELEASE);
   return 0;
 }
 
 void v_clear(struct vector *v) {
-  v->size = 0;
+  uint64 *old_data = v->data;
+  __atomic_store_n(&v->size, 0, __ATOMIC_RELEASE);
   v->capacity = 0;
-  if (v->data != 0) {
-    kfree(v->data);
-  }
+  __atomic_store_n(&v->data, 0, __ATOMIC_RELEASE);
+  v_retire_data(old_data);
+  if (v->freemap) kfree(v->freemap);
+  v->freemap = 0;
+  v->freesum = 0;
+}
+
+// Index of the lowest set bit of x != 0, by de Bruijn multiplication.
+// __builtin_ctzl() would need libgcc on harts without Zbb, and the
+// kernel isn't linked against it.
+static int ctz(uint64 x) {
+  static const char pos[64] = {
+    0,  1,  48, 2,  57, 49, 28, 3,  61, 58, 50, 42, 38, 29, 17, 4,
+    62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+    63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+    46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9,  13, 8,  7,  6,
+  };
+  return pos[((x & -x) * 0x03f79d71b4cb0a89UL) >> 58];
 }
 
-int first_zero(struct vector *v) {
-  int i = 0;
-  for (; i < v->size; i++) {
-    if (v_get(v, i) == 0) return i;
+// One summary word covers 4096 slots, so this is a single step for any
+// size the kernel reaches.
+static int first_zero(struct vector *v) {
+  int n = sum_words(v->capacity);
+  for (int s = 0; s < n; s++) {
+    if (v->freesum[s] == 0) continue;
+    int w = s * 64 + ctz(v->freesum[s]);
+    return w * 64 + ctz(v->freemap[w]);
   }
-  return i;
+  return v->size;
 }
 
 int v_replace_first_zero(struct vector *v, uint64 val) {
@@ -83,11 +175,36 @@ uint64 v_pop_back(struct vector *v) {
   if (v->size == 0) {
     panic("vector pop back");
   }
-  v->size--;
-  return v->data[v->size];
+  uint64 val = v->data[v->size - 1];
+  if (val == 0) mark_used(v, v->size - 1);
+  __atomic_store_n(&v->size, v->size - 1, __ATOMIC_RELEASE);
+  return val;
 }
 
 void v_resize(struct vector *v, int new_size) {
   if (v->capacity < new_size) panic("v_resize: capacity lesser");
-  v->size = new_size;
+  for (int i = v->size; i < new_size; i++) {
+    if (v->data[i] == 0) mark_free(v, i);
+  }
+  for (int i = new_size; i < v->size; i++) {
+    if (v->data[i] == 0) mark_used(v, i);
+  }
+  __atomic_store_n(&v->size, new_size, __ATOMIC_RELEASE);
+}
+
+void v_compact(struct vector *v) {
+  int n = v->size;
+  // Each slot dropped here was pushed once, so this is O(1) amortized.
+  while (n > 0 && v->data[n - 1] == 0) {
+    n--;
+    mark_used(v, n);
+  }
+  __atomic_store_n(&v->size, n, __ATOMIC_RELEASE);
+
+  // Halve until at least a quarter is in use, leaving room to grow back
+  // without reallocating straight away. Keeping the old storage is fine
+  // if the smaller one can't be allocated.
+  int cap = v->capacity;
+  while (cap > 4 && n <= cap / 4) cap /= 2;
+  if (cap != v->capacity) v_grow(v, cap);
 }
@@ -4,17 +4,28 @@
 
 // vector keeps uint64 or pointers
 // it can have an array of spinlocks if needed
+// Writers must be serialized by the caller. v_get() may run concurrently
+// with them from inside epoch_enter()/epoch_exit().
 struct vector {
   int size;
   int capacity;
 
   uint64 *data;
+
+  // Zero slots below size, for v_replace_first_zero(): bit i of freemap
+  // is set if data[i] == 0, bit w of freesum if freemap[w] != 0.
+  // Only writers look at them.
+  uint64 *freemap;
+  uint64 *freesum;
 };
 
 void v_init(struct vector *v);
 
 // Returns 0 on success, -1 otherwise
 int v_grow(struct vector *v, int new_capacity);
+
+// Slots at or past size read as 0, so readers that loaded an old size
+// can race with v_compact().
 uint64 v_get(struct vector *v, int i);
 void v_set(struct vector *v, int i, uint64 val);
 
@@ -27,3 +38,7 @@ int v_replace_first_zero(struct vector *v, uint64 val);
 uint64 v_pop_back(struct vector *v);
 
 void v_resize(struct vector *v, int new_size);
+
+// Drops trailing zero slots and gives back storage once at most a
+// quarter of it is in use. Slots that are kept don't move.
+void v_compact(struct vector *v);
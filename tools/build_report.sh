@@ -0,0 +1,33 @@
+#!/bin/bash
+# Build the debug kernel and the release kernel (profile-ordered if
+# pgo/hot.ld exists), run the benchmarks on each under QEMU and print
+# the kernel sizes and benchmark results side by side.
+#   tools/build_report.sh
+
+set -e
+cd "$(dirname "$0")/.."
+
+BENCH=("ringbench" "threadbench" "lockbench" "sysstat")
+mkdir -p pgo
+
+run() {
+  local name=$1
+  shift
+  make clean > /dev/null
+  # the kernel link prints its size
+  make "$@" all | grep -A1 "text.*data.*bss" > "pgo/$name.size"
+  tools/qemu_batch.sh "pgo/$name.log" 600 "${BENCH[@]}"
+}
+
+run debug
+if [ -s pgo/hot.ld ]; then
+  run release RELEASE=1 PGO=pgo/hot.ld
+else
+  run release RELEASE=1
+fi
+
+for name in debug release; do
+  echo "== $name"
+  cat "pgo/$name.size"
+  grep -v '@done\|^init:\|^xv6\|^hart\|^$' "pgo/$name.log" || true
+done
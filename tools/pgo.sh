@@ -0,0 +1,22 @@
+#!/bin/bash
+# Profile-guided kernel layout. Builds the release kernel, profiles
+# usertests and grind under QEMU with user/prof, lists the hottest
+# kernel functions in pgo/hot.ld and relinks the release kernel with
+# them placed together at the start of .text.
+#   tools/pgo.sh [grind calls]
+# Then compare against the debug build with tools/build_report.sh.
+
+set -e
+cd "$(dirname "$0")/.."
+
+calls=${1:-20000}
+mkdir -p pgo
+
+make clean > /dev/null
+make RELEASE=1 all
+tools/qemu_batch.sh pgo/console.log 3600 \
+  "prof usertests -q" "prof grind $calls"
+python3 tools/pgo_order.py pgo/console.log > pgo/hot.ld
+echo "pgo: $(wc -l < pgo/hot.ld) hot functions in pgo/hot.ld"
+
+make RELEASE=1 PGO=pgo/hot.ld all
@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+"""Turn kernel prof samples into a hot function order for kernel.ld.
+
+Reads the "@prof ..." lines that user/prof prints, counts the kernel
+samples that land in each function of kernel/kernel.sym, and prints
+one input section rule per function, hottest first, for the
+$K/hot.ld list (see the Makefile). The kernel that was profiled must
+be the -ffunction-sections release build being relinked, so that its
+function names match its section names.
+
+    python3 tools/pgo_order.py console.log > pgo/hot.ld
+"""
+
+import collections
+import os
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from prof_fold import ROOT, Symbols  # noqa: E402
+
+# Functions with fewer samples than this stay where they were.
+MIN_SAMPLES = 2
+
+
+def main():
+    kernel = Symbols(os.path.join(ROOT, "kernel", "kernel.sym"))
+    counts = collections.Counter()
+
+    for line in open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin:
+        parts = line.split()
+        if len(parts) < 6 or parts[0] != "@prof" or parts[4] != "k":
+            continue
+        # The interrupted function counts in full, its callers a little,
+        # so that short hot paths end up next to each other.
+        pcs = [int(pc, 16) for pc in parts[5:]]
+        counts[kernel.lookup(pcs[0])] += 4
+        for pc in pcs[1:]:
+            counts[kernel.lookup(pc - 4)] += 1
+
+    for name, n in counts.most_common():
+        if n < MIN_SAMPLES * 4 or name.startswith("0x"):
+            continue
+        print("*(.text.%s)" % name)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Fold prof samples into stacks for flame graphs.
+
+Reads the "@prof ..." lines that user/prof prints (from a saved QEMU
+console log, say), symbolizes them against kernel/kernel.sym and
+user/<name>.sym, and prints one "frame;frame;... count" line per distinct
+stack, outermost frame first, as flamegraph.pl expects.
+
+    python3 tools/prof_fold.py console.log > prof.folded
+"""
+
+import bisect
+import collections
+import os
+import sys
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+
+class Symbols:
+    def __init__(self, path):
+        self.addrs = []
+        self.names = []
+        if not os.path.exists(path):
+            return
+        entries = []
+        with open(path) as f:
+            for line in f:
+                parts = line.split()
+                if len(parts) != 2:
+                    continue
+                try:
+                    entries.append((int(parts[0], 16), parts[1]))
+                except ValueError:
+                    continue
+        entries.sort()
+        self.addrs = [a for a, _ in entries]
+        self.names = [n for _, n in entries]
+
+    def lookup(self, addr):
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i < 0:
+            return "0x%x" % addr
+        return self.names[i]
+
+
+def main():
+    kernel = Symbols(os.path.join(ROOT, "kernel", "kernel.sym"))
+    users = {}
+    stacks = collections.Counter()
+
+    for line in open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin:
+        parts = line.split()
+        if len(parts) < 6 or parts[0] != "@prof":
+            continue
+        pid, name, mode = parts[1], parts[2], parts[4]
+        pcs = [int(pc, 16) for pc in parts[5:]]
+        if mode == "u":
+            if name not in users:
+                users[name] = Symbols(os.path.join(ROOT, "user", name + ".sym"))
+            syms = users[name]
+        else:
+            syms = kernel
+        # Return addresses point just past the call; look up the call.
+        frames = [syms.lookup(pcs[0])]
+        frames += [syms.lookup(pc - 4) for pc in pcs[1:]]
+        frames.reverse()
+        root = name if pid != "0" else "idle"
+        stacks[";".join([root, "[%s]" % mode] + frames)] += 1
+
+    for stack, count in sorted(stacks.items()):
+        print(stack, count)
+
+
+if __name__ == "__main__":
+    main()
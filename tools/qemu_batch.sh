@@ -0,0 +1,58 @@
+#!/bin/bash
+# Boot the built kernel and fs.img under QEMU, run shell commands one
+# after another and save the console output, then stop QEMU.
+#   tools/qemu_batch.sh log seconds 'command' ...
+# Gives up on a command that runs longer than the given seconds.
+
+QEMU=qemu-system-riscv64
+K=kernel
+
+if test -z "$CPUS"; then
+  CPUS=3
+fi
+
+log=$1
+limit=$2
+shift 2
+
+QEMUOPTS=("-machine" "virt" "-bios" "none" "-kernel" "$K/kernel" "-m" "128M" "-smp" "$CPUS")
+QEMUOPTS+=("-global" "virtio-mmio.force-legacy=false")
+QEMUOPTS+=("-drive" "file=fs.img,if=none,format=raw,id=x0")
+QEMUOPTS+=("-device" "virtio-blk-device,drive=x0,bus=virtio-mmio-bus.0")
+QEMUOPTS+=("-nographic")
+
+fifo=$(mktemp -u)
+mkfifo "$fifo"
+$QEMU "${QEMUOPTS[@]}" < "$fifo" > "$log" 2>&1 &
+qemu=$!
+exec 3> "$fifo"
+
+# Wait for a console line starting with $1.
+wait_for() {
+  local end=$((SECONDS + limit))
+  until grep -q "^$1" "$log"; do
+    if ((SECONDS >= end)) || ! kill -0 $qemu 2> /dev/null; then
+      echo "qemu_batch: gave up waiting for \"$1\"" >&2
+      return 1
+    fi
+    sleep 1
+  done
+}
+
+status=0
+if wait_for "init: starting sh"; then
+  n=0
+  for cmd in "$@"; do
+    n=$((n + 1))
+    echo "$cmd; echo @done $n" >&3
+    wait_for "@done $n" || { status=1; break; }
+  done
+else
+  status=1
+fi
+
+exec 3>&-
+kill $qemu 2> /dev/null
+wait $qemu 2> /dev/null
+rm -f "$fifo"
+exit $status
@@ -0,0 +1,31 @@
+// Print the kernel log.
+//   dmesg [-c]
+// -c clears it afterwards.
+
+#include "../kernel/fs/fcntl.h"
+#include "../kernel/kmsg.h"
+#include "user.h"
+
+char buf[KMSG_SIZE];
+
+int main(int argc, char **argv) {
+  int fd, n, clear = 0;
+
+  if (argc == 2 && strcmp(argv[1], "-c") == 0)
+    clear = 1;
+  else if (argc != 1) {
+    fprintf(2, "usage: dmesg [-c]\n");
+    exit(1);
+  }
+  if ((fd = open("/kmsg", O_RDWR)) < 0) {
+    fprintf(2, "dmesg: can't open /kmsg\n");
+    exit(1);
+  }
+  if ((n = read(fd, buf, sizeof(buf))) < 0) {
+    fprintf(2, "dmesg: read failed\n");
+    exit(1);
+  }
+  write(1, buf, n);
+  if (clear) write(fd, "", 1);
+  exit(0);
+}
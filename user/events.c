@@ -0,0 +1,38 @@
+// Show the kernel event counters.
+//   events [-r]
+// -r resets them.
+
+#include "../kernel/events.h"
+#include "../kernel/fs/fcntl.h"
+#include "user.h"
+
+static char *names[] = {
+    [EV_FORK] "fork",       [EV_SWITCH] "switch", [EV_SYSCALL] "syscall",
+    [EV_DEVINTR] "devintr", [EV_TICK] "tick",     [EV_IPI] "ipi",
+    [EV_KALLOC] "kalloc",
+};
+
+uint64 ev[NEVENT];
+
+int main(int argc, char **argv) {
+  int fd;
+
+  if ((fd = open("/events", O_RDWR)) < 0) {
+    fprintf(2, "events: can't open /events\n");
+    exit(1);
+  }
+  if (argc == 2 && strcmp(argv[1], "-r") == 0) {
+    write(fd, "", 1);
+    exit(0);
+  }
+  if (argc != 1) {
+    fprintf(2, "usage: events [-r]\n");
+    exit(1);
+  }
+  if (read(fd, ev, sizeof(ev)) != sizeof(ev)) {
+    fprintf(2, "events: short read\n");
+    exit(1);
+  }
+  for (int i = 0; i < NEVENT; i++) printf("%s\t%l\n", names[i], ev[i]);
+  exit(0);
+}
@@ -1,5 +1,8 @@
 //
 // run random system calls in parallel forever.
+//   grind [calls]
+// with an argument, each of the two children makes that many calls and
+// grind exits; tools/pgo.sh uses this as a workload.
 //
 
 #include "../kernel/fs/fcntl.h"
@@ -34,6 +37,8 @@ unsigned long rand_next = 1;
 
 int rand(void) { return (do_rand(&rand_next)); }
 
+uint64 limit;  // calls per child, or 0 for no limit
+
 void go(int which_child) {
   int fd = -1;
   static char buf[999];
@@ -47,7 +52,7 @@ void go(int which_child) {
   }
   chdir("/");
 
-  while (1) {
+  while (limit == 0 || iters < limit) {
     iters++;
     if ((iters % 500) == 0) write(1, which_child ? "B" : "A", 1);
     int what = rand() % 23;
@@ -312,7 +317,8 @@ void iter() {
   exit(0);
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+  if (argc > 1) limit = atoi(argv[1]);
   while (1) {
     int pid = fork();
     if (pid == 0) {
@@ -322,6 +328,7 @@ int main() {
     if (pid > 0) {
       wait(0);
     }
+    if (limit) exit(0);
     sleep(20);
     rand_next += 1;
   }
@@ -16,6 +16,14 @@ int main(void) {
   dup(0);  // stdout
   dup(0);  // stderr
 
+  // The stats and debug devices; fails if they're already there.
+  mknod("sysstat", SYSSTAT, 0);
+  mknod("strace", STRACE, 0);
+  mknod("prof", PROF, 0);
+  mknod("lockstat", LOCKSTAT, 0);
+  mknod("events", EVENTS, 0);
+  mknod("kmsg", KMSG, 0);
+
   for (;;) {
     printf("init: starting sh\n");
     pid = fork();
@@ -0,0 +1,76 @@
+// Compare the spinlock types under contention: one process per hart
+// hammers a shared kernel lock of each type for a while.
+//   lockbench [ms]
+// Throughput is total acquisitions per millisecond; fairness is the
+// smallest per-hart count as a percentage of the largest.
+
+#include "../kernel/param.h"
+#include "../kernel/util/spinlock.h"
+#include "user.h"
+
+static char *names[] = {
+    [SPIN_TAS] "tas",
+    [SPIN_TICKET] "ticket",
+    [SPIN_MCS] "mcs",
+};
+
+int main(int argc, char **argv) {
+  int ms = 200, harts = 0, hart[NCPU], fds[2];
+  uint64 mask;
+
+  if (argc > 1) ms = atoi(argv[1]);
+  if (ms <= 0 || ms > 5000) {
+    fprintf(2, "usage: lockbench [ms], at most 5000\n");
+    exit(1);
+  }
+  if (sched_getaffinity(0, &mask) < 0) {
+    fprintf(2, "lockbench: sched_getaffinity failed\n");
+    exit(1);
+  }
+  for (int h = 0; h < NCPU; h++)
+    if (mask & (1UL << h)) hart[harts++] = h;
+  if (pipe(fds) < 0) {
+    fprintf(2, "lockbench: pipe failed\n");
+    exit(1);
+  }
+
+  printf("%d harts, %d ms per lock type\n", harts, ms);
+  printf("TYPE\tACQ/ms\tMIN\tMAX\tFAIR\n");
+  for (int type = 0; type < sizeof(names) / sizeof(names[0]); type++) {
+    // Leave the children time to get to their harts before starting.
+    uint64 start = uptime_us() + 50000, end = start + ms * 1000;
+
+    for (int i = 0; i < harts; i++) {
+      int pid = fork();
+      if (pid < 0) {
+        fprintf(2, "lockbench: fork failed\n");
+        exit(1);
+      }
+      if (pid == 0) {
+        uint64 n;
+        sched_setaffinity(0, 1UL << hart[i]);
+        while (uptime_us() < start)
+          ;
+        n = lockbench(type, end);
+        write(fds[1], &n, sizeof(n));
+        exit(0);
+      }
+    }
+
+    uint64 total = 0, min = -1, max = 0;
+    for (int i = 0; i < harts; i++) {
+      uint64 n;
+      if (read(fds[0], &n, sizeof(n)) != sizeof(n) || n == -1) {
+        fprintf(2, "lockbench: child failed\n");
+        exit(1);
+      }
+      total += n;
+      if (n < min) min = n;
+      if (n > max) max = n;
+    }
+    for (int i = 0; i < harts; i++) wait(0);
+    printf("%s\t%l\t%l\t%l\t%l%%\n", names[type], total / ms, min, max,
+           max ? min * 100 / max : 0);
+  }
+  exit(0);
+}
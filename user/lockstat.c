@@ -0,0 +1,89 @@
+// Show spinlock and sleeplock contention, busiest first. For sleeplocks
+// SLEEP counts the contended acquisitions that slept; the rest spun.
+//   lockstat [-r] [-n]
+// -r resets the counters. -n sums each lock name over its call sites.
+// Needs a kernel built with LOCKSTAT=1.
+
+#include "../kernel/fs/fcntl.h"
+#include "../kernel/param.h"
+#include "../kernel/util/lockstat.h"
+#include "user.h"
+
+#define MAXSTAT (NCPU * 128)
+
+struct lockstat st[MAXSTAT];
+
+// Fold entries with the same name into the first one.
+static int by_name(int n) {
+  int m = 0;
+
+  for (int i = 0; i < n; i++) {
+    int j;
+    for (j = 0; j < m; j++)
+      if (strcmp(st[j].name, st[i].name) == 0) break;
+    if (j == m) {
+      st[m++] = st[i];
+      st[j].site = 0;
+      continue;
+    }
+    st[j].acquisitions += st[i].acquisitions;
+    st[j].contended += st[i].contended;
+    st[j].spin_cycles += st[i].spin_cycles;
+    if (st[i].max_hold > st[j].max_hold) st[j].max_hold = st[i].max_hold;
+    st[j].sleeps += st[i].sleeps;
+  }
+  return m;
+}
+
+static void sort(int n) {
+  for (int i = 1; i < n; i++) {
+    struct lockstat s = st[i];
+    int j = i;
+    for (; j > 0 && st[j - 1].spin_cycles < s.spin_cycles; j--)
+      st[j] = st[j - 1];
+    st[j] = s;
+  }
+}
+
+int main(int argc, char **argv) {
+  int fd, n, names = 0;
+
+  if ((fd = open("/lockstat", O_RDWR)) < 0) {
+    fprintf(2, "lockstat: can't open /lockstat\n");
+    exit(1);
+  }
+  if (argc == 2 && strcmp(argv[1], "-r") == 0) {
+    if (write(fd, "", 1) != 1) {
+      fprintf(2, "lockstat: kernel not built with LOCKSTAT=1\n");
+      exit(1);
+    }
+    exit(0);
+  }
+  if (argc == 2 && strcmp(argv[1], "-n") == 0)
+    names = 1;
+  else if (argc != 1) {
+    fprintf(2, "usage: lockstat [-r] [-n]\n");
+    exit(1);
+  }
+
+  if ((n = read(fd, st, sizeof(st))) < 0) {
+    fprintf(2, "lockstat: kernel not built with LOCKSTAT=1\n");
+    exit(1);
+  }
+  n /= sizeof(st[0]);
+  if (names) n = by_name(n);
+  sort(n);
+
+  printf("LOCK\t\tSITE\t\tACQ\tCONT\tSPIN\tMAXHOLD\tSLEEP\n");
+  for (int i = 0; i < n; i++) {
+    struct lockstat *s = &st[i];
+    printf("%s%s\t", s->name, strlen(s->name) < 8 ? "\t" : "");
+    if (names)
+      printf("-\t\t");
+    else
+      printf("%p\t", s->site);
+    printf("%l\t%l\t%l\t%l\t%l\n", s->acquisitions, s->contended,
+           s->spin_cycles, s->max_hold, s->sleeps);
+  }
+  exit(0);
+}
@@ -0,0 +1,71 @@
+// Profile a command by sampling it on clock ticks.
+//   prof [-s slice_us] command [args...]
+// Prints one "@prof pid name hart k|u pc..." line per sample, innermost
+// frame first, for tools/prof_fold.py to symbolize. -s shortens the time
+// slice while profiling, to take more samples (default 1000us).
+
+#include "../kernel/fs/fcntl.h"
+#include "../kernel/prof.h"
+#include "user.h"
+
+#define NREC 8
+
+// Copy samples from the device to stdout until sampling stops.
+static void drain(int fd) {
+  struct prof_sample s[NREC];
+  int n;
+
+  while ((n = read(fd, s, sizeof(s))) > 0) {
+    for (int i = 0; i < n / sizeof(s[0]); i++) {
+      printf("@prof %d %s %d %s", s[i].pid, s[i].name[0] ? s[i].name : "-",
+             s[i].hart, s[i].user ? "u" : "k");
+      for (int j = 0; j < s[i].depth; j++) printf(" %p", s[i].pc[j]);
+      printf("\n");
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  int slice = 1000, fd, pid, drainer;
+
+  if (argc > 2 && strcmp(argv[1], "-s") == 0) {
+    slice = atoi(argv[2]);
+    argv += 2;
+    argc -= 2;
+  }
+  if (argc < 2) {
+    fprintf(2, "usage: prof [-s slice_us] command [args...]\n");
+    exit(1);
+  }
+  if ((fd = open("/prof", O_RDWR)) < 0) {
+    fprintf(2, "prof: can't open /prof\n");
+    exit(1);
+  }
+
+  int old = sched_slice(slice);
+  if (old < 0) {
+    fprintf(2, "prof: bad slice %d\n", slice);
+    exit(1);
+  }
+  write(fd, "1", 1);
+
+  if ((drainer = fork()) == 0) {
+    drain(fd);
+    exit(0);
+  }
+  if ((pid = fork()) == 0) {
+    close(fd);
+    exec(argv[1], argv + 1);
+    fprintf(2, "prof: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  if (drainer < 0 || pid < 0) fprintf(2, "prof: fork failed\n");
+
+  // The drainer only exits once sampling stops.
+  while (pid > 0 && wait(0) != pid)
+    ;
+  write(fd, "0", 1);
+  sched_slice(old);
+  if (drainer > 0) wait(0);
+  exit(0);
+}
@@ -0,0 +1,27 @@
+// Helpers for the system call ring, see kernel/uring.h.
+
+#include "user.h"
+
+// Next free submission entry, or 0 if the ring is full. Fill it in
+// and pass it to ring_push().
+struct ring_sqe *ring_sqe(struct uring *r) {
+  uint tail = r->sq_tail;
+  if (tail - __atomic_load_n(&r->sq_head, __ATOMIC_ACQUIRE) >= RING_ENTRIES)
+    return 0;
+  return &r->sq[tail % RING_ENTRIES];
+}
+
+// Queue the entry returned by ring_sqe().
+void ring_push(struct uring *r) {
+  __atomic_store_n(&r->sq_tail, r->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+// Take the oldest completion into *cqe. Returns 1 if there was one,
+// 0 if there are none ready.
+int ring_reap(struct uring *r, struct ring_cqe *cqe) {
+  uint head = r->cq_head;
+  if (head == __atomic_load_n(&r->cq_tail, __ATOMIC_ACQUIRE)) return 0;
+  *cqe = r->cq[head % RING_ENTRIES];
+  __atomic_store_n(&r->cq_head, head + 1, __ATOMIC_RELEASE);
+  return 1;
+}
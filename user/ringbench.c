@@ -0,0 +1,79 @@
+// Compare plain system calls with the same calls batched through the
+// system call ring.
+//   ringbench [calls]
+
+#include "../kernel/fs/fcntl.h"
+#include "../kernel/syscall_numbers.h"
+#include "user.h"
+
+int n = 10000;
+struct uring *ring;
+
+// Run n copies of the call through the ring, a full ring at a time.
+static void batched(int op, uint64 a0, uint64 a1, uint64 a2) {
+  struct ring_sqe *sqe;
+  struct ring_cqe cqe;
+
+  for (int left = n; left > 0;) {
+    int queued = 0;
+    while (queued < left && (sqe = ring_sqe(ring)) != 0) {
+      sqe->op = op;
+      sqe->args[0] = a0;
+      sqe->args[1] = a1;
+      sqe->args[2] = a2;
+      sqe->user_data = queued;
+      ring_push(ring);
+      queued++;
+    }
+    if (ring_enter(queued) != queued) {
+      fprintf(2, "ringbench: ring_enter failed\n");
+      exit(1);
+    }
+    while (ring_reap(ring, &cqe)) {
+      if (cqe.res == -1) {
+        fprintf(2, "ringbench: call %d failed\n", (int)cqe.user_data);
+        exit(1);
+      }
+    }
+    left -= queued;
+  }
+}
+
+static void report(char *what, uint64 plain, uint64 ring) {
+  printf("%s: %d calls, plain %dus, ring %dus\n", what, n, (int)plain,
+         (int)ring);
+}
+
+int main(int argc, char **argv) {
+  uint64 t0, t1, t2;
+  char c = 'x';
+
+  if (argc > 1) n = atoi(argv[1]);
+  if ((ring = ring_setup()) == (struct uring *)-1) {
+    fprintf(2, "ringbench: ring_setup failed\n");
+    exit(1);
+  }
+
+  t0 = uptime_us();
+  for (int i = 0; i < n; i++) getpid();
+  t1 = uptime_us();
+  batched(SYS_getpid, 0, 0, 0);
+  t2 = uptime_us();
+  report("getpid", t1 - t0, t2 - t1);
+
+  int fd = open("ringbench.tmp", O_CREATE | O_RDWR | O_TRUNC);
+  if (fd < 0) {
+    fprintf(2, "ringbench: can't create ringbench.tmp\n");
+    exit(1);
+  }
+  t0 = uptime_us();
+  for (int i = 0; i < n; i++) write(fd, &c, 1);
+  t1 = uptime_us();
+  batched(SYS_write, fd, (uint64)&c, 1);
+  t2 = uptime_us();
+  report("1-byte write", t1 - t0, t2 - t1);
+  close(fd);
+  unlink("ringbench.tmp");
+
+  exit(0);
+}
@@ -54,6 +54,58 @@ void panic(char *);
 struct cmd *parsecmd(char *);
 void runcmd(struct cmd *) __attribute__((noreturn));
 
+// Start a plain command, possibly with redirections, through spawn(),
+// so the shell isn't copied. acts has room for SPAWN_MAXACTS entries.
+// Returns the pid, -1 on failure, or -2 if cmd needs a forked shell.
+int spawncmd(struct cmd *cmd, struct spawn_action *acts, int nact) {
+  struct execcmd *ecmd;
+  struct redircmd *rcmd;
+  int pid;
+
+  switch (cmd->type) {
+    case EXEC:
+      ecmd = (struct execcmd *)cmd;
+      if (ecmd->argv[0] == 0) return -2;
+      if ((pid = spawn(ecmd->argv[0], ecmd->argv, acts, nact)) < 0)
+        fprintf(2, "spawn %s failed\n", ecmd->argv[0]);
+      return pid;
+
+    case REDIR:
+      if (nact == SPAWN_MAXACTS) return -2;
+      rcmd = (struct redircmd *)cmd;
+      acts[nact].type = SPAWN_OPEN;
+      acts[nact].fd = rcmd->fd;
+      acts[nact].path = rcmd->file;
+      acts[nact].omode = rcmd->mode;
+      return spawncmd(rcmd->cmd, acts, nact + 1);
+
+    default:
+      return -2;
+  }
+}
+
+// Run one side of a pipeline with fd connected to p[fd].
+void pipeside(struct cmd *cmd, int p[2], int fd) {
+  struct spawn_action acts[SPAWN_MAXACTS];
+
+  acts[0].type = SPAWN_DUP2;
+  acts[0].fd = p[fd];
+  acts[0].newfd = fd;
+  acts[1].type = SPAWN_CLOSE;
+  acts[1].fd = p[0];
+  acts[2].type = SPAWN_CLOSE;
+  acts[2].fd = p[1];
+  if (spawncmd(cmd, acts, 3) != -2) return;
+
+  if (fork1() == 0) {
+    close(fd);
+    dup(p[fd]);
+    close(p[0]);
+    close(p[1]);
+    runcmd(cmd);
+  }
+}
+
 // Execute cmd.  Never returns.
 void runcmd(struct cmd *cmd) {
   int p[2];
@@ -96,20 +148,8 @@ void runcmd(struct cmd *cmd) {
     case PIPE:
       pcmd = (struct pipecmd *)cmd;
       if (pipe(p) < 0) panic("pipe");
-      if (fork1() == 0) {
-        close(1);
-        dup(p[1]);
-        close(p[0]);
-        close(p[1]);
-        runcmd(pcmd->left);
-      }
-      if (fork1() == 0) {
-        close(0);
-        dup(p[0]);
-        close(p[0]);
-        close(p[1]);
-        runcmd(pcmd->right);
-      }
+      pipeside(pcmd->left, p, 1);
+      pipeside(pcmd->right, p, 0);
       close(p[0]);
       close(p[1]);
       wait(0);
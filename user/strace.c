@@ -0,0 +1,52 @@
+// Run a command, printing the system calls it and its children make.
+//   strace command [args...]
+
+#include "../kernel/fs/fcntl.h"
+#include "../kernel/sysstat.h"
+#include "sysnames.h"
+#include "user.h"
+
+#define NREC 16
+
+int main(int argc, char **argv) {
+  struct trace_rec rec[NREC];
+  int fd, pid, n;
+
+  if (argc < 2) {
+    fprintf(2, "usage: strace command [args...]\n");
+    exit(1);
+  }
+  if ((fd = open("/strace", O_RDONLY)) < 0) {
+    fprintf(2, "strace: can't open /strace\n");
+    exit(1);
+  }
+
+  if ((pid = fork()) < 0) {
+    fprintf(2, "strace: fork failed\n");
+    exit(1);
+  }
+  if (pid == 0) {
+    close(fd);
+    trace(0, 1);
+    exec(argv[1], argv + 1);
+    fprintf(2, "strace: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+
+  // Print records until the command itself exits.
+  for (int done = 0; !done && (n = read(fd, rec, sizeof(rec))) > 0;) {
+    for (int i = 0; i < n / sizeof(rec[0]); i++) {
+      struct trace_rec *r = &rec[i];
+      if (r->num == SYS_exit) {
+        fprintf(2, "[%d] exit(%d)\n", r->pid, (int)r->args[0]);
+        if (r->pid == pid) done = 1;
+        continue;
+      }
+      fprintf(2, "[%d] %s(0x%x, 0x%x, 0x%x) = %d\n", r->pid,
+              sysname(r->num), (int)r->args[0], (int)r->args[1],
+              (int)r->args[2], (int)r->ret);
+    }
+  }
+  wait(0);
+  exit(0);
+}
@@ -0,0 +1,50 @@
+// System call names, for sysstat and strace.
+
+#include "../kernel/syscall_numbers.h"
+
+static char *sysnames[] = {
+    [SYS_fork] "fork",
+    [SYS_exit] "exit",
+    [SYS_wait] "wait",
+    [SYS_pipe] "pipe",
+    [SYS_read] "read",
+    [SYS_kill] "kill",
+    [SYS_exec] "exec",
+    [SYS_fstat] "fstat",
+    [SYS_chdir] "chdir",
+    [SYS_dup] "dup",
+    [SYS_getpid] "getpid",
+    [SYS_sbrk] "sbrk",
+    [SYS_sleep] "sleep",
+    [SYS_uptime] "uptime",
+    [SYS_open] "open",
+    [SYS_write] "write",
+    [SYS_mknod] "mknod",
+    [SYS_unlink] "unlink",
+    [SYS_link] "link",
+    [SYS_mkdir] "mkdir",
+    [SYS_close] "close",
+    [SYS_havemem] "havemem",
+    [SYS_sched_setaffinity] "sched_setaffinity",
+    [SYS_sched_getaffinity] "sched_getaffinity",
+    [SYS_getrusage] "getrusage",
+    [SYS_procstat] "procstat",
+    [SYS_spawn] "spawn",
+    [SYS_clone] "clone",
+    [SYS_join] "join",
+    [SYS_futex_wait] "futex_wait",
+    [SYS_futex_wake] "futex_wake",
+    [SYS_ring_setup] "ring_setup",
+    [SYS_ring_enter] "ring_enter",
+    [SYS_nanosleep] "nanosleep",
+    [SYS_sched_slice] "sched_slice",
+    [SYS_trace] "trace",
+    [SYS_lockbench] "lockbench",
+};
+
+static char *sysname(int num) {
+  if (num > 0 && num < sizeof(sysnames) / sizeof(sysnames[0]) &&
+      sysnames[num])
+    return sysnames[num];
+  return "?";
+}
@@ -0,0 +1,86 @@
+// Show per-system-call counts, errors and latencies.
+//   sysstat [-r] [-h name]
+// -r resets the counters. -h shows the latency histogram of one call.
+
+#include "../kernel/fs/fcntl.h"
+#include "../kernel/mem/memlayout.h"
+#include "../kernel/sysstat.h"
+#include "sysnames.h"
+#include "user.h"
+
+#define CYCLES_PER_US (CLINT_FREQ / 1000000)
+
+struct sysstat st[SYSSTAT_NSYSCALL];
+
+// Upper bound in cycles of the bucket holding the given percentile.
+static uint64 percentile(struct sysstat *s, int pct) {
+  uint64 seen = 0;
+
+  for (int i = 0; i < SYSSTAT_BUCKETS; i++) {
+    seen += s->hist[i];
+    if (seen * 100 >= s->calls * pct) return 1UL << i;
+  }
+  return 1UL << (SYSSTAT_BUCKETS - 1);
+}
+
+static void show_all(void) {
+  printf("CALL\t\tCALLS\tERRORS\tAVG us\tP50 us\tP99 us\n");
+  for (int i = 0; i < SYSSTAT_NSYSCALL; i++) {
+    struct sysstat *s = &st[i];
+    if (s->calls == 0) continue;
+    char *name = sysname(i);
+    printf("%s%s\t%l\t%l\t%l\t%l\t%l\n", name, strlen(name) < 8 ? "\t" : "",
+           s->calls, s->errors, s->time / s->calls / CYCLES_PER_US,
+           percentile(s, 50) / CYCLES_PER_US,
+           percentile(s, 99) / CYCLES_PER_US);
+  }
+}
+
+static void show_one(char *name) {
+  struct sysstat *s = 0;
+  uint64 max = 0;
+
+  for (int i = 0; i < SYSSTAT_NSYSCALL; i++)
+    if (strcmp(sysname(i), name) == 0) s = &st[i];
+  if (s == 0) {
+    fprintf(2, "sysstat: no system call %s\n", name);
+    exit(1);
+  }
+
+  printf("%s: %l calls, %l errors\n", name, s->calls, s->errors);
+  for (int i = 0; i < SYSSTAT_BUCKETS; i++)
+    if (s->hist[i] > max) max = s->hist[i];
+  for (int i = 0; i < SYSSTAT_BUCKETS; i++) {
+    if (s->hist[i] == 0) continue;
+    printf("%l\t..%l cycles\t%l\t", i ? 1UL << (i - 1) : 0, 1UL << i,
+           s->hist[i]);
+    for (int j = 0; j < s->hist[i] * 40 / max; j++) printf("*");
+    printf("\n");
+  }
+}
+
+int main(int argc, char **argv) {
+  int fd;
+
+  if ((fd = open("/sysstat", O_RDWR)) < 0) {
+    fprintf(2, "sysstat: can't open /sysstat\n");
+    exit(1);
+  }
+  if (argc == 2 && strcmp(argv[1], "-r") == 0) {
+    write(fd, "", 1);
+    exit(0);
+  }
+  if (read(fd, st, sizeof(st)) != sizeof(st)) {
+    fprintf(2, "sysstat: short read\n");
+    exit(1);
+  }
+  if (argc == 3 && strcmp(argv[1], "-h") == 0)
+    show_one(argv[2]);
+  else if (argc == 1)
+    show_all();
+  else {
+    fprintf(2, "usage: sysstat [-r] [-h name]\n");
+    exit(1);
+  }
+  exit(0);
+}
@@ -0,0 +1,75 @@
+// Threads on top of clone() and join(), and futex-based mutexes.
+// malloc() isn't thread-safe, so only one thread at a time may create
+// or join threads.
+
+#include "user.h"
+
+#define THREAD_STACK_SIZE 4096
+
+struct thread {
+  int tid;
+  void *(*fn)(void *);
+  void *arg;
+  void *ret;
+  char *stack;
+};
+
+static void thread_start(void *p) {
+  struct thread *t = p;
+
+  t->ret = t->fn(t->arg);
+  exit(0);
+}
+
+// Run fn(arg) in a new thread. Returns 0 on success, -1 on failure.
+int thread_create(struct thread **tp, void *(*fn)(void *), void *arg) {
+  struct thread *t;
+
+  if ((t = malloc(sizeof(struct thread))) == 0) return -1;
+  if ((t->stack = malloc(THREAD_STACK_SIZE)) == 0) {
+    free(t);
+    return -1;
+  }
+  t->fn = fn;
+  t->arg = arg;
+  t->tid = clone(thread_start, t, t->stack + THREAD_STACK_SIZE);
+  if (t->tid < 0) {
+    free(t->stack);
+    free(t);
+    return -1;
+  }
+  *tp = t;
+  return 0;
+}
+
+// Wait for t to finish, store what its function returned in *ret,
+// and free it. Returns 0 on success, -1 on failure.
+int thread_join(struct thread *t, void **ret) {
+  if (join(t->tid, 0) < 0) return -1;
+  if (ret) *ret = t->ret;
+  free(t->stack);
+  free(t);
+  return 0;
+}
+
+// A mutex takes no system calls unless it's contended: a locker that
+// finds it held marks it as having waiters and sleeps in futex_wait(),
+// and only an unlock of a mutex with waiters calls futex_wake().
+
+void mutex_lock(struct mutex *m) {
+  int c = 0;
+
+  if (__atomic_compare_exchange_n(&m->state, &c, 1, 0, __ATOMIC_ACQUIRE,
+                                  __ATOMIC_RELAXED))
+    return;
+  if (c != 2) c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+  while (c != 0) {
+    futex_wait(&m->state, 2);
+    c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+  }
+}
+
+void mutex_unlock(struct mutex *m) {
+  if (__atomic_exchange_n(&m->state, 0, __ATOMIC_RELEASE) == 2)
+    futex_wake(&m->state, 1);
+}
@@ -0,0 +1,66 @@
+// Count primes with 1, 2, 4, ... threads, up to one per hart, to check
+// that threads of a process run in parallel.
+//   threadbench [limit]
+
+#include "user.h"
+
+#define MAXTHREADS 64
+
+int limit = 200000;
+int nthreads;
+
+static int isprime(int n) {
+  if (n < 2) return 0;
+  for (int d = 2; d * d <= n; d++)
+    if (n % d == 0) return 0;
+  return 1;
+}
+
+// Thread k checks the numbers equal to k modulo nthreads.
+static void *count(void *arg) {
+  uint64 k = (uint64)arg, found = 0;
+
+  for (int n = k; n < limit; n += nthreads) found += isprime(n);
+  return (void *)found;
+}
+
+int main(int argc, char **argv) {
+  struct thread *threads[MAXTHREADS];
+  uint64 mask;
+  int harts = 0;
+
+  if (argc > 1) limit = atoi(argv[1]);
+  if (sched_getaffinity(0, &mask) < 0) {
+    fprintf(2, "threadbench: sched_getaffinity failed\n");
+    exit(1);
+  }
+  for (; mask; mask &= mask - 1) harts++;
+
+  int base = 0;
+  for (nthreads = 1; nthreads <= harts && nthreads <= MAXTHREADS;
+       nthreads *= 2) {
+    int start = uptime();
+    for (int k = 0; k < nthreads; k++) {
+      if (thread_create(&threads[k], count, (void *)(uint64)k) < 0) {
+        fprintf(2, "threadbench: thread_create failed\n");
+        exit(1);
+      }
+    }
+    uint64 primes = 0;
+    for (int k = 0; k < nthreads; k++) {
+      void *found;
+      if (thread_join(threads[k], &found) < 0) {
+        fprintf(2, "threadbench: thread_join failed\n");
+        exit(1);
+      }
+      primes += (uint64)found;
+    }
+    int ticks = uptime() - start;
+    if (nthreads == 1) base = ticks;
+    printf("%d threads: %l primes below %d, %d ticks", nthreads, primes,
+           limit, ticks);
+    if (ticks > 0) printf(", speedup %d%%", base * 100 / ticks);
+    printf("\n");
+  }
+  exit(0);
+}
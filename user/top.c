@@ -0,0 +1,119 @@
+// Show per-process CPU usage and run queue latency, refreshed every second.
+//   top [-n iterations] [-p pid]
+// With -p, show the run queue latency histogram of one process.
+
+#include "user.h"
+
+#define MAXPROCS 64
+
+static char *states[] = {"unused", "used", "sleep", "runble", "run", "zombie"};
+
+struct procstat ps[MAXPROCS];
+
+// Previous sample, to compute CPU usage over the last interval.
+struct {
+  int pid;
+  uint64 cpu_time;
+} prev[MAXPROCS];
+int nprev;
+
+static uint64 prev_cpu_time(int pid) {
+  for (int i = 0; i < nprev; i++)
+    if (prev[i].pid == pid) return prev[i].cpu_time;
+  return 0;
+}
+
+// Upper bound in us of the bucket holding the given percentile of waits.
+static uint64 latency_percentile(struct rusage *ru, int pct) {
+  uint64 total = 0, seen = 0;
+
+  for (int i = 0; i < RUSAGE_LAT_BUCKETS; i++) total += ru->lat_hist[i];
+  if (total == 0) return 0;
+  for (int i = 0; i < RUSAGE_LAT_BUCKETS; i++) {
+    seen += ru->lat_hist[i];
+    if (seen * 100 >= total * pct) return 1UL << i;
+  }
+  return 1UL << (RUSAGE_LAT_BUCKETS - 1);
+}
+
+static void show_all(uint64 interval_us) {
+  int n = procstat(ps, MAXPROCS);
+  if (n < 0) {
+    fprintf(2, "top: procstat failed\n");
+    exit(1);
+  }
+
+  printf("\033[H\033[J");
+  printf("PID\tSTATE\tCPU%%\tCPU ms\tWAIT ms\tVCSW\tIVCSW\tP99 us\tNAME\n");
+  for (int i = 0; i < n; i++) {
+    struct rusage *ru = &ps[i].ru;
+    uint64 pct = 0;
+    if (interval_us != 0)
+      pct = (ru->cpu_time - prev_cpu_time(ps[i].pid)) * 100 / interval_us;
+    printf("%d\t%s\t%l\t%l\t%l\t%l\t%l\t%l\t%s\n", ps[i].pid,
+           states[ps[i].state], pct, ru->cpu_time / 1000,
+           ru->wait_time / 1000, ru->nvcsw, ru->nivcsw,
+           latency_percentile(ru, 99), ps[i].name);
+  }
+
+  for (nprev = 0; nprev < n; nprev++) {
+    prev[nprev].pid = ps[nprev].pid;
+    prev[nprev].cpu_time = ps[nprev].ru.cpu_time;
+  }
+}
+
+static void show_one(int pid) {
+  struct rusage ru;
+  uint64 max = 0;
+
+  if (getrusage(pid, &ru) < 0) {
+    fprintf(2, "top: no process %d\n", pid);
+    exit(1);
+  }
+
+  printf("\033[H\033[J");
+  printf("pid %d: cpu %l ms, wait %l ms, sleep %l ms, vcsw %l, ivcsw %l\n",
+         pid, ru.cpu_time / 1000, ru.wait_time / 1000, ru.sleep_time / 1000,
+         ru.nvcsw, ru.nivcsw);
+  printf("run queue latency:\n");
+  for (int i = 0; i < RUSAGE_LAT_BUCKETS; i++)
+    if (ru.lat_hist[i] > max) max = ru.lat_hist[i];
+  for (int i = 0; i < RUSAGE_LAT_BUCKETS; i++) {
+    if (i == 0)
+      printf("%l\t..%l us\t%l\t", 0UL, 1UL, ru.lat_hist[i]);
+    else
+      printf("%l\t..%l us\t%l\t", 1UL << (i - 1), 1UL << i, ru.lat_hist[i]);
+    int stars = max ? ru.lat_hist[i] * 40 / max : 0;
+    for (int j = 0; j < stars; j++) printf("*");
+    printf("\n");
+  }
+}
+
+int main(int argc, char **argv) {
+  int iterations = -1, pid = -1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      pid = atoi(argv[++i]);
+    } else {
+      fprintf(2, "usage: top [-n iterations] [-p pid]\n");
+      exit(1);
+    }
+  }
+
+  uint64 last = uptime_us();
+  uint64 interval_us = 0;
+  for (int i = 0; iterations < 0 || i < iterations; i++) {
+    if (pid >= 0)
+      show_one(pid);
+    else
+      show_all(interval_us);
+    sleep(10);
+    uint64 now = uptime_us();
+    interval_us = now - last;
+    last = now;
+  }
+  exit(0);
+}
@@ -1,5 +1,9 @@
 #include "../kernel/fs/stat.h"
+#include "../kernel/proc/procstat.h"
+#include "../kernel/proc/spawn.h"
+#include "../kernel/proc/usysdata.h"
 #include "../kernel/types.h"
+#include "../kernel/uring.h"
 
 // system calls
 int fork(void);
@@ -24,6 +28,21 @@ char* sbrk(int);
 int sleep(int);
 int uptime(void);
 uint64 havemem(); // Free memory in bytes
+int sched_setaffinity(int, uint64);
+int sched_getaffinity(int, uint64*);
+int getrusage(int, struct rusage*);
+int procstat(struct procstat*, int);
+int spawn(const char*, char**, struct spawn_action*, int);
+int clone(void (*)(void*), void*, void*);
+int join(int, int*);
+int futex_wait(int*, int);
+int futex_wake(int*, int);
+struct uring* ring_setup(void);
+int ring_enter(int);
+int nanosleep(uint64);
+int sched_slice(int);
+int trace(int, int);
+int lockbench(int, uint64);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -41,3 +60,25 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void*, const void*, uint);
 void* memcpy(void*, const void*, uint);
+
+// ring.c
+struct ring_sqe* ring_sqe(struct uring*);
+void ring_push(struct uring*);
+int ring_reap(struct uring*, struct ring_cqe*);
+
+// vdso.c
+int vgetpid(void);
+int vgethartid(void);
+int vuptime(void);
+int vhartticks(int);
+uint64 uptime_us(void);
+
+// thread.c
+struct thread;
+int thread_create(struct thread**, void* (*)(void*), void*);
+int thread_join(struct thread*, void**);
+struct mutex {
+  int state;  // 0 unlocked, 1 locked, 2 locked with waiters
+};
+void mutex_lock(struct mutex*);
+void mutex_unlock(struct mutex*);
@@ -1,8 +1,15 @@
+#include "../kernel/events.h"
 #include "../kernel/fs/fcntl.h"
 #include "../kernel/fs/fs.h"
+#include "../kernel/kmsg.h"
 #include "../kernel/mem/memlayout.h"
 #include "../kernel/param.h"
+#include "../kernel/prof.h"
 #include "../kernel/riscv.h"
+#include "../kernel/syscall_numbers.h"
+#include "../kernel/sysstat.h"
+#include "../kernel/util/lockstat.h"
+#include "../kernel/util/spinlock.h"
 #include "user.h"
 
 //
@@ -2416,6 +2423,791 @@ void badarg(char *s) {
   exit(0);
 }
 
+// sched_setaffinity() pins the caller, rejects bad arguments,
+// and the mask is inherited by fork().
+void affinity(char *s) {
+  uint64 all, one, mask;
+
+  if (sched_getaffinity(0, &all) < 0 || all == 0) {
+    printf("%s: sched_getaffinity failed\n", s);
+    exit(1);
+  }
+  if (sched_setaffinity(0, 0) != -1) {
+    printf("%s: empty mask accepted\n", s);
+    exit(1);
+  }
+  if (sched_setaffinity(-1, all) != -1) {
+    printf("%s: nonexistent pid accepted\n", s);
+    exit(1);
+  }
+
+  one = all & -all;
+  if (sched_setaffinity(0, one) < 0) {
+    printf("%s: sched_setaffinity failed\n", s);
+    exit(1);
+  }
+  if (sched_getaffinity(0, &mask) < 0 || mask != one) {
+    printf("%s: mask %p, expected %p\n", s, mask, one);
+    exit(1);
+  }
+
+  int pid = fork();
+  if (pid < 0) {
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if (pid == 0) {
+    for (int i = 0; i < 100; i++) getpid();
+    if (sched_getaffinity(0, &mask) < 0 || mask != one) exit(1);
+    exit(0);
+  }
+  int xstatus;
+  wait(&xstatus);
+  if (xstatus != 0) {
+    printf("%s: child didn't inherit affinity\n", s);
+    exit(1);
+  }
+
+  if (sched_setaffinity(0, all) < 0) {
+    printf("%s: restoring affinity failed\n", s);
+    exit(1);
+  }
+}
+
+// spawn() runs a program with its file actions applied,
+// and fails cleanly for a missing program.
+void spawntest(char *s) {
+  char *argv[] = {"echo", "spawned", 0};
+  struct spawn_action act;
+  char buf[16];
+  int pid, xstatus, fd, n;
+
+  act.type = SPAWN_OPEN;
+  act.fd = 1;
+  act.path = "spawnout";
+  act.omode = O_CREATE | O_WRONLY | O_TRUNC;
+  if ((pid = spawn("echo", argv, &act, 1)) < 0) {
+    printf("%s: spawn failed\n", s);
+    exit(1);
+  }
+  if (wait(&xstatus) != pid || xstatus != 0) {
+    printf("%s: spawned echo failed\n", s);
+    exit(1);
+  }
+
+  if ((fd = open("spawnout", O_RDONLY)) < 0) {
+    printf("%s: output file missing\n", s);
+    exit(1);
+  }
+  n = read(fd, buf, sizeof(buf));
+  close(fd);
+  unlink("spawnout");
+  if (n != 8 || memcmp(buf, "spawned\n", 8) != 0) {
+    printf("%s: wrong output\n", s);
+    exit(1);
+  }
+
+  if (spawn("nosuchprogram", argv, 0, 0) != -1) {
+    printf("%s: spawn of a missing program succeeded\n", s);
+    exit(1);
+  }
+}
+
+int clonecount[4];
+
+void *clonebump(void *arg) {
+  int *c = arg;
+  for (int i = 0; i < 1000; i++) (*c)++;
+  return c;
+}
+
+// threads made with clone() share memory with their creator,
+// and thread_join() returns what they returned.
+void clonetest(char *s) {
+  struct thread *t[4];
+  void *ret;
+
+  for (int k = 0; k < 4; k++) {
+    if (thread_create(&t[k], clonebump, &clonecount[k]) < 0) {
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  for (int k = 0; k < 4; k++) {
+    if (thread_join(t[k], &ret) < 0 || ret != &clonecount[k]) {
+      printf("%s: thread_join failed\n", s);
+      exit(1);
+    }
+    if (clonecount[k] != 1000) {
+      printf("%s: count %d, expected 1000\n", s, clonecount[k]);
+      exit(1);
+    }
+  }
+}
+
+struct mutex futexmu;
+int futexcount;
+
+void *futexbump(void *arg) {
+  for (int i = 0; i < 2000; i++) {
+    mutex_lock(&futexmu);
+    futexcount++;
+    mutex_unlock(&futexmu);
+  }
+  return 0;
+}
+
+// futex_wait() returns at once if the word changed, and a
+// futex-based mutex keeps threads from losing updates.
+void futextest(char *s) {
+  struct thread *t[4];
+  int word = 1;
+
+  if (futex_wait(&word, 0) != -1) {
+    printf("%s: futex_wait slept on a changed word\n", s);
+    exit(1);
+  }
+  if (futex_wait((int *)0xeaeb0b5b00002f5eUL, 0) != -1) {
+    printf("%s: futex_wait accepted a bad address\n", s);
+    exit(1);
+  }
+  if (futex_wake(&word, 1) != 0) {
+    printf("%s: futex_wake woke a thread nobody started\n", s);
+    exit(1);
+  }
+
+  for (int k = 0; k < 4; k++) {
+    if (thread_create(&t[k], futexbump, 0) < 0) {
+      printf("%s: thread_create failed\n", s);
+      exit(1);
+    }
+  }
+  for (int k = 0; k < 4; k++) thread_join(t[k], 0);
+  if (futexcount != 4 * 2000) {
+    printf("%s: count %d, expected %d\n", s, futexcount, 4 * 2000);
+    exit(1);
+  }
+}
+
+static void *vdsopid(void *arg) { return (void *)(uint64)vgetpid(); }
+
+// getpid(), uptime() and the hart read from the usysdata pages should
+// agree with the system calls, in children and threads too.
+void vdsotest(char *s) {
+  struct thread *t;
+  void *ret;
+  int pid, xstatus;
+
+  if (vgetpid() != getpid()) {
+    printf("%s: vgetpid %d, getpid %d\n", s, vgetpid(), getpid());
+    exit(1);
+  }
+  int u0 = uptime();
+  int v = vuptime();
+  if (v < u0 || v > uptime()) {
+    printf("%s: vuptime %d out of step with uptime\n", s, v);
+    exit(1);
+  }
+  if (vgethartid() < 0 || vgethartid() >= NCPU) {
+    printf("%s: bad hart %d\n", s, vgethartid());
+    exit(1);
+  }
+
+  // uptime_us() shouldn't go backwards, and should keep up with ticks.
+  uint64 us = uptime_us();
+  int start = uptime();
+  while (uptime() < start + 2) {
+    uint64 now = uptime_us();
+    if (now < us) {
+      printf("%s: uptime_us went backwards\n", s);
+      exit(1);
+    }
+    us = now;
+  }
+  if (us < (uint64)start * 100000) {
+    printf("%s: uptime_us %d behind ticks\n", s, (int)us);
+    exit(1);
+  }
+
+  // The shared page is read-only.
+  pid = fork();
+  if (pid < 0) {
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if (pid == 0) {
+    if (vgetpid() != getpid()) exit(1);
+    *(volatile uint64 *)USYSDATA = 0;
+    exit(2);
+  }
+  wait(&xstatus);
+  if (xstatus != -1) {
+    printf("%s: child exit %d, expected a fault\n", s, xstatus);
+    exit(1);
+  }
+
+  if (thread_create(&t, vdsopid, 0) < 0) {
+    printf("%s: thread_create failed\n", s);
+    exit(1);
+  }
+  thread_join(t, &ret);
+  if ((int)(uint64)ret == getpid() || (int)(uint64)ret <= 0) {
+    printf("%s: thread vgetpid %d\n", s, (int)(uint64)ret);
+    exit(1);
+  }
+}
+
+// Calls queued in the ring run on ring_enter() and complete in order,
+// and ones that can't run from the ring fail.
+void ringtest(char *s) {
+  struct uring *r = ring_setup();
+  struct ring_sqe *sqe;
+  struct ring_cqe cqe;
+  int fds[2];
+  char buf[4];
+
+  if (r == (struct uring *)-1 || ring_setup() != r) {
+    printf("%s: ring_setup failed\n", s);
+    exit(1);
+  }
+  if (pipe(fds) < 0) {
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+
+  int ops[] = {SYS_getpid, SYS_write, SYS_fork, 1000};
+  for (int k = 0; k < 4; k++) {
+    sqe = ring_sqe(r);
+    sqe->op = ops[k];
+    sqe->args[0] = fds[1];
+    sqe->args[1] = (uint64) "abc";
+    sqe->args[2] = 3;
+    sqe->user_data = k;
+    ring_push(r);
+  }
+  if (ring_reap(r, &cqe)) {
+    printf("%s: completion before ring_enter\n", s);
+    exit(1);
+  }
+  if (ring_enter(4) != 4) {
+    printf("%s: ring_enter didn't run 4 calls\n", s);
+    exit(1);
+  }
+  uint64 want[] = {getpid(), 3, -1, -1};
+  for (int k = 0; k < 4; k++) {
+    if (!ring_reap(r, &cqe) || cqe.user_data != k || cqe.res != want[k]) {
+      printf("%s: bad completion %d\n", s, k);
+      exit(1);
+    }
+  }
+  if (read(fds[0], buf, 3) != 3 || memcmp(buf, "abc", 3) != 0) {
+    printf("%s: write through the ring went missing\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  // Without reaping, only RING_ENTRIES calls complete.
+  for (int k = 0; k < 2 * RING_ENTRIES; k++) {
+    if ((sqe = ring_sqe(r)) == 0) {
+      if (ring_enter(RING_ENTRIES) <= 0) break;
+      sqe = ring_sqe(r);
+    }
+    sqe->op = SYS_getpid;
+    ring_push(r);
+  }
+  if (ring_enter(RING_ENTRIES) != 0) {
+    printf("%s: ring_enter overflowed the completions\n", s);
+    exit(1);
+  }
+  int n = 0;
+  while (ring_reap(r, &cqe)) n++;
+  if (n != RING_ENTRIES) {
+    printf("%s: %d completions, expected %d\n", s, n, RING_ENTRIES);
+    exit(1);
+  }
+}
+
+// nanosleep() sleeps at least as long as asked, even below a tick,
+// and sleep() still counts ticks.
+void nanosleeptest(char *s) {
+  uint64 t0 = uptime_us();
+  if (nanosleep(2000000) < 0) {
+    printf("%s: nanosleep failed\n", s);
+    exit(1);
+  }
+  uint64 t1 = uptime_us();
+  if (t1 - t0 < 2000) {
+    printf("%s: nanosleep(2ms) took %dus\n", s, (int)(t1 - t0));
+    exit(1);
+  }
+
+  int start = uptime();
+  sleep(3);
+  if (uptime() - start < 3) {
+    printf("%s: sleep(3) took %d ticks\n", s, uptime() - start);
+    exit(1);
+  }
+
+  // Sleepers are woken in deadline order.
+  int fds[2];
+  char order[3];
+  pipe(fds);
+  for (int k = 0; k < 3; k++) {
+    int pid = fork();
+    if (pid < 0) {
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if (pid == 0) {
+      char c = '0' + k;
+      nanosleep((3 - k) * 50000000UL);
+      write(fds[1], &c, 1);
+      exit(0);
+    }
+  }
+  for (int k = 0; k < 3; k++) wait(0);
+  if (read(fds[0], order, 3) != 3 || memcmp(order, "210", 3) != 0) {
+    printf("%s: sleepers woke out of order\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// Two spinning processes on one hart take turns at the configured
+// time slice, even though the hart turns its clock ticks off while it
+// has a single process to run.
+void slicetest(char *s) {
+  uint64 mask;
+  int fds[2], hart;
+  uint64 span[2][2];
+
+  int old = sched_slice(0);
+  if (old <= 0 || sched_slice(10) != -1) {
+    printf("%s: bad sched_slice %d\n", s, old);
+    exit(1);
+  }
+  if (sched_getaffinity(0, &mask) < 0) {
+    printf("%s: sched_getaffinity failed\n", s);
+    exit(1);
+  }
+  for (hart = 0; (mask & (1UL << hart)) == 0; hart++)
+    ;
+  if (sched_slice(10000) != old) {
+    printf("%s: sched_slice didn't return the old slice\n", s);
+    exit(1);
+  }
+  int ticks0 = vhartticks(hart);
+
+  pipe(fds);
+  for (int k = 0; k < 2; k++) {
+    int pid = fork();
+    if (pid < 0) {
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if (pid == 0) {
+      uint64 t[2];
+      sched_setaffinity(0, 1UL << hart);
+      t[0] = uptime_us();
+      while ((t[1] = uptime_us()) - t[0] < 300000)
+        ;
+      write(fds[1], &k, sizeof(k));
+      write(fds[1], t, sizeof(t));
+      exit(0);
+    }
+  }
+  for (int k = 0; k < 2; k++) {
+    int who;
+    read(fds[0], &who, sizeof(who));
+    read(fds[0], span[who], sizeof(span[who]));
+    wait(0);
+  }
+  close(fds[0]);
+  close(fds[1]);
+  sched_slice(old);
+
+  // With both spinning for 300ms, each started before the other ended.
+  if (span[0][0] > span[1][1] || span[1][0] > span[0][1]) {
+    printf("%s: the processes ran one after the other\n", s);
+    exit(1);
+  }
+  if (vhartticks(hart) - ticks0 < 10) {
+    printf("%s: hart %d took %d ticks\n", s, hart, vhartticks(hart) - ticks0);
+    exit(1);
+  }
+}
+
+// Calls show up in the /sysstat counters, and a traced child's calls
+// and exit show up in /strace.
+void sysstattest(char *s) {
+  static struct sysstat st[SYSSTAT_NSYSCALL];
+  struct trace_rec rec[8];
+  int fd, pid, n;
+
+  if ((fd = open("/sysstat", O_RDONLY)) < 0) {
+    printf("%s: can't open /sysstat\n", s);
+    exit(1);
+  }
+  if (read(fd, st, sizeof(st)) != sizeof(st)) {
+    printf("%s: short read\n", s);
+    exit(1);
+  }
+  uint64 before = st[SYS_getpid].calls;
+  for (int i = 0; i < 10; i++) getpid();
+  read(fd, st, sizeof(st));
+  if (st[SYS_getpid].calls < before + 10) {
+    printf("%s: getpid count %d, expected at least %d\n", s,
+           (int)st[SYS_getpid].calls, (int)before + 10);
+    exit(1);
+  }
+  close(fd);
+
+  if ((fd = open("/strace", O_RDONLY)) < 0) {
+    printf("%s: can't open /strace\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if (pid < 0) {
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if (pid == 0) {
+    trace(0, 1);
+    getpid();
+    exit(3);
+  }
+  int saw_getpid = 0, saw_exit = 0;
+  while (!saw_exit && (n = read(fd, rec, sizeof(rec))) > 0) {
+    for (int i = 0; i < n / sizeof(rec[0]); i++) {
+      if (rec[i].pid != pid) continue;
+      if (rec[i].num == SYS_getpid && rec[i].ret == pid) saw_getpid = 1;
+      if (rec[i].num == SYS_exit && rec[i].args[0] == 3) saw_exit = 1;
+    }
+  }
+  wait(0);
+  close(fd);
+  if (!saw_getpid || !saw_exit) {
+    printf("%s: trace missed the child's calls\n", s);
+    exit(1);
+  }
+}
+
+// The profiler catches this process spinning in user space.
+void proftest(char *s) {
+  struct prof_sample samples[8];
+  int fd, n, mine = 0;
+
+  if ((fd = open("/prof", O_RDWR)) < 0) {
+    printf("%s: can't open /prof\n", s);
+    exit(1);
+  }
+  int old = sched_slice(1000);
+  write(fd, "1", 1);
+  uint64 t0 = uptime_us();
+  while (uptime_us() - t0 < 100000)
+    ;
+  write(fd, "0", 1);
+  sched_slice(old);
+
+  while ((n = read(fd, samples, sizeof(samples))) > 0) {
+    for (int i = 0; i < n / sizeof(samples[0]); i++) {
+      struct prof_sample *p = &samples[i];
+      if (p->pid == getpid() && p->user && p->depth >= 1 &&
+          p->pc[0] < 0x80000000UL)
+        mine++;
+    }
+  }
+  close(fd);
+  if (mine == 0) {
+    printf("%s: no samples of this process\n", s);
+    exit(1);
+  }
+}
+
+// Pipe traffic shows up under the "pipe" lock in /lockstat. Passes
+// without checking anything if the kernel doesn't collect lock stats.
+void lockstattest(char *s) {
+  static struct lockstat st[NCPU * 128];
+  int fd, fds[2], n;
+  uint64 acq = 0;
+  char c = 'x';
+
+  if ((fd = open("/lockstat", O_RDWR)) < 0) {
+    printf("%s: can't open /lockstat\n", s);
+    exit(1);
+  }
+  if (write(fd, "", 1) != 1) {
+    close(fd);
+    return;
+  }
+  if (pipe(fds) < 0) {
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  for (int i = 0; i < 10; i++) {
+    write(fds[1], &c, 1);
+    read(fds[0], &c, 1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  if ((n = read(fd, st, sizeof(st))) < 0) {
+    printf("%s: read failed\n", s);
+    exit(1);
+  }
+  for (int i = 0; i < n / sizeof(st[0]); i++)
+    if (strcmp(st[i].name, "pipe") == 0) acq += st[i].acquisitions;
+  close(fd);
+  if (acq < 20) {
+    printf("%s: %d pipe lock acquisitions, expected at least 20\n", s,
+           (int)acq);
+    exit(1);
+  }
+}
+
+// Two processes contending for each type of bench lock get it, though
+// maybe not both if there's one hart.
+void lockbenchtest(char *s) {
+  int fds[2];
+
+  if (pipe(fds) < 0) {
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  for (int type = SPIN_TAS; type <= SPIN_MCS; type++) {
+    for (int i = 0; i < 2; i++) {
+      int pid = fork();
+      if (pid < 0) {
+        printf("%s: fork failed\n", s);
+        exit(1);
+      }
+      if (pid == 0) {
+        // Timed from here, so a slow fork can't leave no time at all.
+        int n = lockbench(type, uptime_us() + 20000);
+        write(fds[1], &n, sizeof(n));
+        exit(0);
+      }
+    }
+    int total = 0;
+    for (int i = 0; i < 2; i++) {
+      int n = -1;
+      read(fds[0], &n, sizeof(n));
+      wait(0);
+      if (n < 0) {
+        printf("%s: lockbench(%d) failed\n", s, type);
+        exit(1);
+      }
+      total += n;
+    }
+    if (total == 0) {
+      printf("%s: lock type %d never acquired\n", s, type);
+      exit(1);
+    }
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// Readers looking up and stat'ing a file, which take the directory and
+// file inode locks shared, while a writer keeps changing the directory.
+void sharedlookup(char *s) {
+  enum { NREAD = 3, N = 100 };
+  struct stat st;
+  int fd, pid, xstatus, ok = 1;
+
+  unlink("sl/f");
+  unlink("sl/g");
+  unlink("sl");
+  if (mkdir("sl") < 0 || (fd = open("sl/f", O_CREATE | O_RDWR)) < 0) {
+    printf("%s: setup failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  for (int i = 0; i <= NREAD; i++) {
+    pid = fork();
+    if (pid < 0) {
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if (pid == 0) {
+      for (int j = 0; j < N; j++) {
+        if (i == NREAD) {
+          if ((fd = open("sl/g", O_CREATE | O_RDWR)) < 0) exit(1);
+          close(fd);
+          if (unlink("sl/g") < 0) exit(1);
+        } else {
+          if ((fd = open("sl/f", O_RDONLY)) < 0) exit(1);
+          if (fstat(fd, &st) < 0 || st.type != T_FILE) exit(1);
+          close(fd);
+        }
+      }
+      exit(0);
+    }
+  }
+  for (int i = 0; i <= NREAD; i++) {
+    wait(&xstatus);
+    if (xstatus != 0) ok = 0;
+  }
+  unlink("sl/f");
+  unlink("sl");
+  if (!ok) {
+    printf("%s: a child failed\n", s);
+    exit(1);
+  }
+}
+
+// The event counters and the free memory count add up across harts.
+void eventstest(char *s) {
+  uint64 a[NEVENT], b[NEVENT];
+  int fd, xstatus;
+
+  if ((fd = open("/events", O_RDONLY)) < 0) {
+    printf("%s: can't open /events\n", s);
+    exit(1);
+  }
+  if (read(fd, a, sizeof(a)) != sizeof(a)) {
+    printf("%s: short read\n", s);
+    exit(1);
+  }
+  for (int i = 0; i < 10; i++) getpid();
+  int pid = fork();
+  if (pid < 0) {
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if (pid == 0) exit(0);
+  wait(&xstatus);
+  uint64 free = havemem();
+  if (sbrk(10 * PGSIZE) == (char *)-1) {
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  uint64 used = free - havemem();
+  sbrk(-10 * PGSIZE);
+  read(fd, b, sizeof(b));
+  close(fd);
+
+  if (b[EV_SYSCALL] < a[EV_SYSCALL] + 10 || b[EV_FORK] < a[EV_FORK] + 1 ||
+      b[EV_SWITCH] < a[EV_SWITCH] + 1 || b[EV_KALLOC] < a[EV_KALLOC] + 10) {
+    printf("%s: counts didn't go up\n", s);
+    exit(1);
+  }
+  if (used < 10 * PGSIZE) {
+    printf("%s: havemem dropped by %d for 10 pages\n", s, (int)used);
+    exit(1);
+  }
+}
+
+// What the kernel prints about a faulting process shows up in the
+// kernel log.
+void dmesgtest(char *s) {
+  static char log[KMSG_SIZE];
+  char want[32];
+  int fd, n, xstatus;
+
+  int pid = fork();
+  if (pid < 0) {
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if (pid == 0) {
+    *(volatile char *)0x80000000LL = 1;
+    exit(0);
+  }
+  wait(&xstatus);
+  if (xstatus != -1) {
+    printf("%s: child wasn't killed\n", s);
+    exit(1);
+  }
+
+  if ((fd = open("/kmsg", O_RDONLY)) < 0) {
+    printf("%s: can't open /kmsg\n", s);
+    exit(1);
+  }
+  n = read(fd, log, sizeof(log));
+  close(fd);
+  if (n <= 0) {
+    printf("%s: read returned %d\n", s, n);
+    exit(1);
+  }
+
+  // Look for "pid=N\n", built backwards at the end of want[].
+  char *w = want + sizeof(want);
+  *--w = '\n';
+  for (int p = pid; p > 0; p /= 10) *--w = '0' + p % 10;
+  w -= 4;
+  memmove(w, "pid=", 4);
+  int m = want + sizeof(want) - w;
+  for (int i = n - m; i >= 0; i--)
+    if (memcmp(log + i, w, m) == 0) return;
+  printf("%s: no fault message for pid %d in the kernel log\n", s, pid);
+  exit(1);
+}
+
+// A process that pins itself to another hart gets there promptly even
+// when that hart is idle with its clock tick off.
+void pinidle(char *s) {
+  uint64 all;
+
+  if (sched_getaffinity(0, &all) < 0) {
+    printf("%s: sched_getaffinity failed\n", s);
+    exit(1);
+  }
+  uint64 here = 1UL << vgethartid();
+  uint64 there = all & ~here;
+  if (there == 0) return;  // only one hart
+  there &= -there;
+
+  // Keep everything on this hart so the other one goes idle tickless.
+  if (sched_setaffinity(0, here) < 0) {
+    printf("%s: sched_setaffinity failed\n", s);
+    exit(1);
+  }
+  sleep(2);
+
+  int pid = fork();
+  if (pid < 0) {
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if (pid == 0) {
+    uint64 t0 = uptime_us();
+    sched_setaffinity(0, there);
+    uint64 t = uptime_us() - t0;
+    exit((1UL << vgethartid()) == there && t < 500000 ? 0 : 1);
+  }
+
+  // Should the child be stranded, re-pinning it from here wakes its
+  // hart, so a broken kernel fails the test instead of hanging it.
+  int watchdog = fork();
+  if (watchdog < 0) {
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if (watchdog == 0) {
+    sleep(30);
+    sched_setaffinity(pid, there);
+    exit(0);
+  }
+
+  int xstatus;
+  while (wait(&xstatus) != pid)
+    ;
+  kill(watchdog);
+  wait(0);
+  if (sched_setaffinity(0, all) < 0) {
+    printf("%s: restoring affinity failed\n", s);
+    exit(1);
+  }
+  if (xstatus != 0) {
+    printf("%s: child stalled moving to an idle hart\n", s);
+    exit(1);
+  }
+}
+
 struct test {
   void (*f)(char *);
   char *s;
@@ -2480,6 +3272,22 @@ struct test {
     {sbrklast, "sbrklast"},
     {sbrk8000, "sbrk8000"},
     {badarg, "badarg"},
+    {affinity, "affinity"},
+    {spawntest, "spawntest"},
+    {clonetest, "clonetest"},
+    {futextest, "futextest"},
+    {vdsotest, "vdsotest"},
+    {ringtest, "ringtest"},
+    {nanosleeptest, "nanosleeptest"},
+    {slicetest, "slicetest"},
+    {sysstattest, "sysstattest"},
+    {proftest, "proftest"},
+    {lockstattest, "lockstattest"},
+    {lockbenchtest, "lockbenchtest"},
+    {sharedlookup, "sharedlookup"},
+    {eventstest, "eventstest"},
+    {dmesgtest, "dmesgtest"},
+    {pinidle, "pinidle"},
 
     {0, 0},
 };
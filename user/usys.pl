@@ -37,3 +37,18 @@ entry("sbrk");
 entry("sleep");
 entry("uptime");
 entry("havemem");
+entry("sched_setaffinity");
+entry("sched_getaffinity");
+entry("getrusage");
+entry("procstat");
+entry("spawn");
+entry("clone");
+entry("join");
+entry("futex_wait");
+entry("futex_wake");
+entry("ring_setup");
+entry("ring_enter");
+entry("nanosleep");
+entry("sched_slice");
+entry("trace");
+entry("lockbench");
@@ -0,0 +1,44 @@
+// System calls answered from the kernel's read-only pages, without
+// trapping. See kernel/proc/usysdata.h.
+
+#include "../kernel/mem/memlayout.h"
+#include "user.h"
+
+static struct uthread *self(void) {
+  struct uthread *t;
+  asm volatile("mv %0, tp" : "=r"(t));
+  return t;
+}
+
+static volatile struct usysdata *sysdata(void) {
+  return (volatile struct usysdata *)USYSDATA;
+}
+
+// Same as getpid().
+int vgetpid(void) { return self()->pid; }
+
+// Hart the calling thread is running on. It may be moved to another
+// one at any time, so this is only a hint.
+int vgethartid(void) { return ((volatile struct uthread *)self())->hartid; }
+
+static uint64 rdtime(void) {
+  uint64 t;
+  asm volatile("rdtime %0" : "=r"(t));
+  return t - sysdata()->mtime_base;
+}
+
+// Same as uptime().
+int vuptime(void) { return rdtime() / sysdata()->tick_interval; }
+
+// Clock interrupts hart has taken, or -1 if there's no such hart.
+int vhartticks(int hart) {
+  if (hart < 0 || hart >= NCPU) return -1;
+  return sysdata()->hart_ticks[hart];
+}
+
+// Microseconds since boot.
+uint64 uptime_us(void) {
+  uint64 t = rdtime();
+  uint64 freq = sysdata()->mtime_freq;
+  return t / freq * 1000000 + t % freq * 1000000 / freq;
+}